@@ -0,0 +1,92 @@
+/**
+ * ages a heap of its own under churn with a mix of sizes and lifetimes, and samples how
+ * fragmented it gets over time.
+ *     aging [lifo|address] [steps] [steps per sample] [heap MiB]
+ * Every step picks a random slot of the live set; an expired object there is freed, and an empty
+ * slot gets a new object. Most objects are small and short-lived, a few are large or live for a
+ * long time, which is what pins down high-order blocks.
+ * Each sample prints the step, the largest free order, the free blocks of every order in
+ * MemAllocator and the occupancy of every slab type in percent. Runs with the two placement
+ * policies from the same seed are directly comparable.
+ */
+#include "host.h"
+
+// objects alive at a time, at most
+#define LIVE 4096
+
+static struct {
+    void *ptr;
+    long expiry;
+} live[LIVE];
+
+/**
+ * @brief sizes of a typical kernel: mostly slab cells, then blocks of a few KiB and rarely
+ * buffers of up to a MiB.
+ */
+static size_t object_size(uint64_t *seed) {
+    const int dice = (int) (host_random(seed) % 100);
+    if (dice < 60) return 1 + host_random(seed) % 128;
+    if (dice < 85) return 129 + host_random(seed) % (4096 - 128);
+    if (dice < 95) return 4097 + host_random(seed) % (60 << 10);
+    return (64 << 10) + host_random(seed) % (960 << 10);
+}
+
+static long object_lifetime(uint64_t *seed) {
+    if (host_random(seed) % 10) return 1 + (long) (host_random(seed) % LIVE);
+    return 1 + (long) (host_random(seed) % (64 * LIVE));
+}
+
+static void sample(struct pmm_heap *heap, const long step) {
+    struct pmm_sample s;
+    pmm_heap_sample(heap, &s);
+    printf("%10ld %7d ", step, s.largest_order);
+    for (int i = 0; i <= heap->mem.max_order - heap->mem.base_order; ++i) {
+        printf(" %5d", s.free_blocks[i] + (i < FAST_ORDERS ? s.fast_blocks[i] : 0));
+    }
+    printf("  |");
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        printf(" %4d", s.cells[i] ? s.used_cells[i] * 100 / s.cells[i] : 0);
+    }
+    printf("\n");
+}
+
+int main(const int argc, char *argv[]) {
+    const char *policy = argc > 1 ? argv[1] : "lifo";
+    const long steps = argc > 2 ? atol(argv[2]) : 10000000;
+    const long every = argc > 3 ? atol(argv[3]) : steps / 20;
+    const size_t heap_size = (size_t) (argc > 4 ? atol(argv[4]) : 256) << 20;
+    CHECK(steps > 0 && every > 0);
+    CHECK(strcmp(policy, "lifo") == 0 || strcmp(policy, "address") == 0);
+
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(heap_size);
+    pmm_heap_set_placement(heap, strcmp(policy, "lifo") == 0 ? PLACEMENT_LIFO : PLACEMENT_ADDRESS);
+
+    printf("placement %s, %d objects alive at most\n", policy, LIVE);
+    printf("%10s %7s  free blocks of order %d ...  | used %% of slab types\n", "step", "largest",
+           heap->mem.base_order);
+    uint64_t seed = 1;
+    long failures = 0;
+    for (long step = 0; step < steps; ++step) {
+        const int j = (int) (host_random(&seed) % LIVE);
+        if (live[j].ptr && live[j].expiry <= step) {
+            pmm_heap_free(heap, live[j].ptr);
+            live[j].ptr = NULL;
+        } else if (!live[j].ptr) {
+            live[j].ptr = pmm_heap_alloc(heap, object_size(&seed));
+            live[j].expiry = step + object_lifetime(&seed);
+            // running out is what fragmentation looks like at the end, it isn't an error
+            if (!live[j].ptr) failures++;
+        }
+        if ((step + 1) % every == 0) sample(heap, step + 1);
+    }
+    printf("failed allocations: %ld\n", failures);
+
+    CHECK(pmm_heap_check(heap) == 0);
+    for (int j = 0; j < LIVE; ++j) {
+        if (live[j].ptr) pmm_heap_free(heap, live[j].ptr);
+    }
+    CHECK(pmm_heap_check(heap) == 0);
+    host_exit();
+    return 0;
+}
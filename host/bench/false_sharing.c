@@ -0,0 +1,58 @@
+/**
+ * every cpu allocates and frees small cells on its own slab manager, so nothing is shared but
+ * cache lines. Built against pmm_host and pmm_host_packed (-DPMM_PACKED), the difference in
+ * throughput as cpus are added is what the cache line padding of per-cpu state is worth.
+ *     false_sharing [max cpus] [operations per cpu]
+ * For each number of cpus, it prints the layout, the cpus and the operations per second.
+ */
+#include "host.h"
+
+#ifdef PMM_PACKED
+#define LAYOUT "packed"
+#else
+#define LAYOUT "aligned"
+#endif
+
+// cells each cpu keeps at a time
+#define BATCH 16
+
+struct config {
+    long ops;
+    int ready; // cpus that are about to start
+};
+
+static void run(const int cpu, void *arg) {
+    struct config *config = arg;
+    void *cells[BATCH];
+    __atomic_fetch_add(&config->ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&config->ready, __ATOMIC_SEQ_CST) < cpu_count());
+
+    for (long i = 0; i < config->ops; i += 2 * BATCH) {
+        for (int j = 0; j < BATCH; ++j) {
+            cells[j] = pmm->alloc(SLAB_CATEGORY[j % SLAB_TYPES]);
+            CHECK(cells[j]);
+        }
+        for (int j = 0; j < BATCH; ++j) {
+            pmm->free(cells[j]);
+        }
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    const int max_cpus = argc > 1 ? atoi(argv[1]) : 8;
+    const long ops = argc > 2 ? atol(argv[2]) : 4000000;
+    CHECK(max_cpus > 0 && max_cpus <= HOST_MAX_CPUS && ops > 0);
+
+    printf("%-8s %4s %14s\n", "layout", "cpus", "ops/s");
+    for (int cpus = 1; cpus <= max_cpus; cpus *= 2) {
+        host_init(cpus, 64 << 20);
+        struct config config = {.ops = ops};
+        const uint64_t begin = host_clock_ns();
+        host_run(run, &config);
+        const uint64_t elapsed = host_clock_ns() - begin;
+        printf("%-8s %4d %14.0f\n", LAYOUT, cpus, (double) ops * cpus * 1e9 / (double) elapsed);
+        CHECK(pmm_check() == 0);
+    }
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,192 @@
+/**
+ * kalloc and kfree latency under five allocation patterns, built against pmm_host_latency
+ * (-DPMM_LATENCY) so that every operation is counted in the per-cpu histograms.
+ *     latency [max cpus] [operations per cpu] [pattern]
+ * - steady: every cpu keeps a working set of small cells and replaces a random one per step.
+ * - burst: every cpu allocates a batch of cells and then frees all of them.
+ * - producer: even cpus allocate and hand cells to the next cpu, which frees them, so every
+ *   free is a cross-cpu one. An unpaired cpu frees its own cells.
+ * - churn: like steady, but sizes are spread over every order up to MAX_REQUEST_MEM.
+ * - aging: like burst, but one in eight cells of every batch stays alive for the rest of the
+ *   run, so later batches are placed around them.
+ * For each pattern and number of cpus, it prints p50, p99 and p99.9 of allocations and frees
+ * in ticks of PMM_CLOCK, followed by the histogram, where bucket i counts operations that
+ * took [2^i, 2^(i+1)) ticks.
+ */
+#include "host.h"
+
+// cells in the working set of steady and churn, and in a batch of burst and aging
+#define BATCH 64
+// cells that stay alive in aging, per cpu
+#define AGED 1024
+// cells in flight between a producer and its consumer
+#define RING 256
+
+struct ring {
+    void *cells[RING];
+    uint64_t head CACHE_ALIGNED; // written by the consumer
+    uint64_t tail CACHE_ALIGNED; // written by the producer
+};
+
+struct config {
+    long ops;
+    int ready; // cpus that are about to start
+    struct ring rings[HOST_MAX_CPUS / 2];
+};
+
+static void start(struct config *config) {
+    __atomic_fetch_add(&config->ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&config->ready, __ATOMIC_SEQ_CST) < cpu_count());
+}
+
+static size_t small_size(uint64_t *seed) {
+    return 1 + host_random(seed) % SLAB_CATEGORY[SLAB_TYPES - 1];
+}
+
+/**
+ * @brief a size of a uniformly chosen order, up to MAX_REQUEST_MEM.
+ */
+static size_t any_size(uint64_t *seed) {
+    int max_order = 0;
+    while ((size_t) 1 << (max_order + 1) <= MAX_REQUEST_MEM) max_order++;
+    const int order = 3 + (int) (host_random(seed) % (uint64_t) (max_order - 2));
+    return ((size_t) 1 << (order - 1)) + 1 + host_random(seed) % ((size_t) 1 << (order - 1));
+}
+
+static void replace(const long ops, uint64_t *seed, size_t (*size)(uint64_t *)) {
+    void *cells[BATCH] = {NULL};
+    for (long i = 0; i < ops; ++i) {
+        const int j = (int) (host_random(seed) % BATCH);
+        if (cells[j]) pmm->free(cells[j]);
+        cells[j] = pmm->alloc(size(seed));
+        // large sizes may fail once the heap is fragmented, that's part of the pattern
+        if (cells[j]) *(uint8_t *) cells[j] = 1;
+    }
+    for (int j = 0; j < BATCH; ++j) {
+        if (cells[j]) pmm->free(cells[j]);
+    }
+}
+
+static void steady(const int cpu, void *arg) {
+    struct config *config = arg;
+    uint64_t seed = cpu + 1;
+    start(config);
+    replace(config->ops, &seed, small_size);
+}
+
+static void churn(const int cpu, void *arg) {
+    struct config *config = arg;
+    uint64_t seed = cpu + 1;
+    start(config);
+    replace(config->ops, &seed, any_size);
+}
+
+static void batches(struct config *config, const int cpu, const int keep) {
+    static void *aged[HOST_MAX_CPUS][AGED];
+    int aged_count = 0;
+    void *cells[BATCH];
+    uint64_t seed = cpu + 1;
+    start(config);
+    for (long i = 0; i < config->ops; i += 2 * BATCH) {
+        for (int j = 0; j < BATCH; ++j) {
+            cells[j] = pmm->alloc(small_size(&seed));
+            CHECK(cells[j]);
+        }
+        for (int j = 0; j < BATCH; ++j) {
+            if (keep && aged_count < AGED && host_random(&seed) % 8 == 0) {
+                aged[cpu][aged_count++] = cells[j];
+            } else {
+                pmm->free(cells[j]);
+            }
+        }
+    }
+    for (int j = 0; j < aged_count; ++j) {
+        pmm->free(aged[cpu][j]);
+    }
+}
+
+static void burst(const int cpu, void *arg) {
+    batches(arg, cpu, 0);
+}
+
+static void aging(const int cpu, void *arg) {
+    batches(arg, cpu, 1);
+}
+
+static void producer(const int cpu, void *arg) {
+    struct config *config = arg;
+    uint64_t seed = cpu + 1;
+    start(config);
+    if (cpu % 2 == 0 && cpu + 1 == cpu_count()) {
+        // unpaired
+        for (long i = 0; i < config->ops; ++i) {
+            pmm->free(pmm->alloc(small_size(&seed)));
+        }
+        return;
+    }
+
+    struct ring *ring = &config->rings[cpu / 2];
+    for (long i = 0; i < config->ops; ++i) {
+        if (cpu % 2 == 0) {
+            void *p = pmm->alloc(small_size(&seed));
+            CHECK(p);
+            while (__atomic_load_n(&ring->tail, __ATOMIC_RELAXED) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING) {
+                yield();
+            }
+            ring->cells[ring->tail % RING] = p;
+            __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+        } else {
+            while (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+                yield();
+            }
+            pmm->free(ring->cells[ring->head % RING]);
+            __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static const struct {
+    const char *name;
+    host_task task;
+} patterns[] = {
+    {"steady", steady}, {"burst", burst}, {"producer", producer}, {"churn", churn}, {"aging", aging},
+};
+
+static void report(const char *pattern, const int cpus, const char *name, const enum pmm_op op) {
+    uint64_t buckets[LATENCY_BUCKETS];
+    const uint64_t total = pmm_latency_histogram(op, buckets);
+    printf("%-8s %4d %-5s %10llu %8llu %8llu %8llu  ", pattern, cpus, name, (unsigned long long) total,
+           (unsigned long long) pmm_latency_percentile(op, 500),
+           (unsigned long long) pmm_latency_percentile(op, 990),
+           (unsigned long long) pmm_latency_percentile(op, 999));
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        if (buckets[i]) printf(" %d:%llu", i, (unsigned long long) buckets[i]);
+    }
+    printf("\n");
+}
+
+int main(const int argc, char *argv[]) {
+    const int max_cpus = argc > 1 ? atoi(argv[1]) : 8;
+    const long ops = argc > 2 ? atol(argv[2]) : 1000000;
+    const char *only = argc > 3 ? argv[3] : NULL;
+    CHECK(max_cpus > 0 && max_cpus <= HOST_MAX_CPUS && ops > 0);
+
+    printf("%-8s %4s %-5s %10s %8s %8s %8s   %s\n", "pattern", "cpus", "op", "count", "p50", "p99", "p99.9",
+           "bucket:count");
+    for (size_t i = 0; i < LENGTH(patterns); ++i) {
+        if (only && strcmp(only, patterns[i].name) != 0) continue;
+        for (int cpus = 1; cpus <= max_cpus; cpus *= 2) {
+            host_init(cpus, (size_t) 1 << 30);
+            static struct config config;
+            memset(&config, 0, sizeof(config));
+            config.ops = ops;
+            pmm_latency_reset();
+            host_run(patterns[i].task, &config);
+            report(patterns[i].name, cpus, "alloc", PMM_OP_ALLOC);
+            report(patterns[i].name, cpus, "free", PMM_OP_FREE);
+            CHECK(pmm_check() == 0);
+        }
+    }
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * hammers the default heap from every cpu with random kalloc, kfree, pmm_alloc_pages and
+ * pmm_free_pages, and catches any byte handed out twice.
+ *     stress [max cpus] [operations per cpu] [heap MiB]
+ * Every cpu keeps a working set of objects and replaces a random one per step. A shadow map
+ * holds one byte per 8-byte granule of heap: the cpu that owns it plus one, or 0. Claiming a
+ * granule that is owned already, or giving back one that isn't owned by this cpu, fails at once.
+ * Every object must also be aligned to its size rounded up to a power of two, as kalloc promises.
+ * For each number of cpus, it prints the operations per second and the speedup over one cpu,
+ * after the heap has passed pmm_check with every object freed.
+ */
+#include "host.h"
+
+// objects each cpu keeps at a time
+#define WORKING_SET 64
+// bytes per entry of the shadow map
+#define GRANULE 8
+
+struct object {
+    void *ptr;
+    size_t size;
+    int order; // of a page block; 0, if it's from kalloc
+};
+
+struct config {
+    long ops;
+    int ready; // cpus that are about to start
+    uint8_t *shadow;
+    uint64_t failures;
+};
+
+static size_t power_of_two(const size_t size) {
+    size_t p = 1;
+    while (p < size) p <<= 1;
+    return p;
+}
+
+static uint8_t *shadow_of(struct config *config, const void *ptr) {
+    return &config->shadow[((uintptr_t) ptr - (uintptr_t) heap.start) / GRANULE];
+}
+
+static void claim(struct config *config, const struct object *object, const uint8_t owner) {
+    uint8_t *shadow = shadow_of(config, object->ptr);
+    for (size_t i = 0; i < (object->size + GRANULE - 1) / GRANULE; ++i) {
+        uint8_t expected = 0;
+        CHECK(__atomic_compare_exchange_n(&shadow[i], &expected, owner, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    // the memory itself must be writable, at both ends
+    ((uint8_t *) object->ptr)[0] = owner;
+    ((uint8_t *) object->ptr)[object->size - 1] = owner;
+}
+
+static void give_back(struct config *config, const struct object *object, const uint8_t owner) {
+    CHECK(((uint8_t *) object->ptr)[0] == owner && ((uint8_t *) object->ptr)[object->size - 1] == owner);
+    uint8_t *shadow = shadow_of(config, object->ptr);
+    for (size_t i = 0; i < (object->size + GRANULE - 1) / GRANULE; ++i) {
+        CHECK(__atomic_exchange_n(&shadow[i], 0, __ATOMIC_RELAXED) == owner);
+    }
+}
+
+/**
+ * @brief mostly slab cells, then blocks of a few KiB, page blocks of up to four pages and rarely
+ * buffers of up to 256 KiB.
+ */
+static void pick(struct object *object, uint64_t *seed) {
+    const int dice = (int) (host_random(seed) % 100);
+    object->order = 0;
+    if (dice < 70) {
+        object->size = 1 + host_random(seed) % 128;
+    } else if (dice < 90) {
+        object->size = 129 + host_random(seed) % (8192 - 128);
+    } else if (dice < 98) {
+        object->order = 13 + (int) (host_random(seed) % 3);
+        object->size = (size_t) 1 << object->order;
+    } else {
+        object->size = 8193 + host_random(seed) % (248 << 10);
+    }
+}
+
+static void release(struct config *config, struct object *object, const uint8_t owner) {
+    give_back(config, object, owner);
+    if (object->order) {
+        CHECK(pmm_free_pages(object->ptr, object->order) == 0);
+    } else {
+        pmm->free(object->ptr);
+    }
+    object->ptr = NULL;
+}
+
+static void run(const int cpu, void *arg) {
+    struct config *config = arg;
+    struct object objects[WORKING_SET] = {{NULL}};
+    const uint8_t owner = (uint8_t) (cpu + 1);
+    uint64_t seed = cpu + 1;
+    __atomic_fetch_add(&config->ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&config->ready, __ATOMIC_SEQ_CST) < cpu_count());
+
+    for (long i = 0; i < config->ops; ++i) {
+        struct object *object = &objects[host_random(&seed) % WORKING_SET];
+        if (object->ptr) {
+            release(config, object, owner);
+            continue;
+        }
+        pick(object, &seed);
+        object->ptr = object->order ? pmm_alloc_pages(object->order) : pmm->alloc(object->size);
+        if (!object->ptr) {
+            // larger blocks may run out as the heap fragments, which is no error
+            __atomic_fetch_add(&config->failures, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        CHECK((uintptr_t) object->ptr % power_of_two(object->size) == 0);
+        claim(config, object, owner);
+    }
+    for (int j = 0; j < WORKING_SET; ++j) {
+        if (objects[j].ptr) release(config, &objects[j], owner);
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    const int max_cpus = argc > 1 ? atoi(argv[1]) : 8;
+    const long ops = argc > 2 ? atol(argv[2]) : 1000000;
+    const size_t heap_size = (size_t) (argc > 3 ? atol(argv[3]) : 256) << 20;
+    CHECK(max_cpus > 0 && max_cpus <= HOST_MAX_CPUS && ops > 0);
+
+    printf("%4s %14s %8s %10s\n", "cpus", "ops/s", "speedup", "failures");
+    double single = 0;
+    for (int cpus = 1; cpus <= max_cpus; cpus *= 2) {
+        host_init(cpus, heap_size);
+        struct config config = {.ops = ops};
+        config.shadow = calloc(heap_size / GRANULE, 1);
+        CHECK(config.shadow);
+        const uint64_t begin = host_clock_ns();
+        host_run(run, &config);
+        const uint64_t elapsed = host_clock_ns() - begin;
+        const double throughput = (double) ops * cpus * 1e9 / (double) elapsed;
+        if (cpus == 1) single = throughput;
+        printf("%4d %14.0f %8.2f %10llu\n", cpus, throughput, throughput / single,
+               (unsigned long long) config.failures);
+
+        // everything is given back, so that no granule is owned anymore
+        for (size_t i = 0; i < heap_size / GRANULE; ++i) {
+            CHECK(config.shadow[i] == 0);
+        }
+        free(config.shadow);
+        CHECK(pmm_check() == 0);
+    }
+    host_exit();
+    return 0;
+}
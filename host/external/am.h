@@ -0,0 +1,26 @@
+/* the parts of AbstractMachine that pmm.c relies on, implemented by host/host.c so that the
+ * allocator runs as a plain process. */
+#ifndef AM_H__
+#define AM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    void *start, *end;
+} Area;
+
+extern Area heap;
+
+int cpu_count(void);
+
+int cpu_current(void);
+
+int atomic_xchg(int *addr, int newval);
+
+void yield(void);
+
+void halt(int code) __attribute__((__noreturn__));
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef KERNEL_H__
+#define KERNEL_H__
+
+#include "am.h"
+
+#define MODULE(mod) \
+    typedef struct mod_##mod##_t mod_##mod##_t; \
+    extern mod_##mod##_t *mod; \
+    struct mod_##mod##_t
+
+#define MODULE_DEF(mod) \
+    extern mod_##mod##_t __##mod##_obj; \
+    mod_##mod##_t *mod = &__##mod##_obj; \
+    mod_##mod##_t __##mod##_obj
+
+MODULE(pmm) {
+    void (*init)();
+    void *(*alloc)(size_t size);
+    void (*free)(void *ptr);
+};
+
+#endif
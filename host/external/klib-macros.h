@@ -0,0 +1,16 @@
+#ifndef KLIB_MACROS_H__
+#define KLIB_MACROS_H__
+
+#define ROUNDUP(a, sz)      ((((uintptr_t)a) + (sz) - 1) & ~((sz) - 1))
+#define ROUNDDOWN(a, sz)    ((((uintptr_t)a)) & ~((sz) - 1))
+#define LENGTH(arr)         (sizeof(arr) / sizeof((arr)[0]))
+#define panic_on(cond, s) \
+    do { \
+        if (cond) { \
+            printf("AM Panic: %s @ %s:%d\n", (s), __FILE__, __LINE__); \
+            halt(1); \
+        } \
+    } while (0)
+#define panic(s) panic_on(1, s)
+
+#endif
@@ -0,0 +1,12 @@
+/* klib is libc on the host. */
+#ifndef KLIB_H__
+#define KLIB_H__
+
+#include "am.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#endif
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+
+#include "host.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// common.h defines spin locks as C99 inline functions, these are their external definitions.
+extern inline void lock_init(SpinLock *lock);
+
+extern inline void lock_acquire(SpinLock *lock);
+
+extern inline void lock_release(SpinLock *lock);
+
+Area heap;
+
+static int cpus = 1;
+static __thread int current_cpu;
+
+// where `heap` and the heaps of `host_heap_create` are mapped, so that `host_exit` unmaps them
+#define HOST_MAPPINGS 16
+static struct {
+    void *addr;
+    size_t len;
+} mappings[HOST_MAPPINGS];
+static int mapping_count;
+
+int cpu_count(void) {
+    return cpus;
+}
+
+int cpu_current(void) {
+    return current_cpu;
+}
+
+int atomic_xchg(int *addr, const int newval) {
+    const int old = __atomic_exchange_n(addr, newval, __ATOMIC_SEQ_CST);
+    // a spin lock is taken by someone else, let it run in case there are more threads than cores
+    if (old && newval) sched_yield();
+    return old;
+}
+
+void yield(void) {
+    sched_yield();
+}
+
+void halt(const int code) {
+    fprintf(stderr, "halt(%d)\n", code);
+    abort();
+}
+
+/**
+ * @brief map size bytes aligned to the largest power of two not above size, so that the
+ * buddy allocator can carve it into blocks as large as on a real machine.
+ */
+static void *host_map(const size_t size) {
+    size_t align = 1;
+    while (align * 2 <= size) align *= 2;
+    uint8_t *raw = mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    CHECK(raw != MAP_FAILED);
+    uint8_t *addr = (uint8_t *) ROUNDUP(raw, align);
+    CHECK(mapping_count < HOST_MAPPINGS);
+    mappings[mapping_count].addr = raw;
+    mappings[mapping_count].len = size + align;
+    mapping_count++;
+    return addr;
+}
+
+/**
+ * @brief map a fresh `heap` of heap_size bytes and initialize pmm for the given number of cpus.
+ * Anything left from the previous `host_init` is unmapped first.
+ */
+void host_init(const int cpu_number, const size_t heap_size) {
+    CHECK(cpu_number > 0 && cpu_number <= HOST_MAX_CPUS);
+    host_exit();
+    cpus = cpu_number;
+    current_cpu = 0;
+    heap.start = host_map(heap_size);
+    heap.end = (uint8_t *) heap.start + heap_size;
+    pmm->init();
+}
+
+void host_exit() {
+    for (int i = 0; i < mapping_count; ++i) {
+        munmap(mappings[i].addr, mappings[i].len);
+    }
+    mapping_count = 0;
+}
+
+void host_set_cpu(const int cpu) {
+    CHECK(cpu >= 0 && cpu < cpus);
+    current_cpu = cpu;
+}
+
+struct host_thread {
+    pthread_t thread;
+    int cpu;
+    host_task task;
+    void *arg;
+};
+
+static void *host_thread_main(void *p) {
+    struct host_thread *t = p;
+    current_cpu = t->cpu;
+    t->task(t->cpu, t->arg);
+    return NULL;
+}
+
+/**
+ * @brief run task on every cpu at the same time, one thread per cpu, and wait for all of them.
+ */
+void host_run(const host_task task, void *arg) {
+    struct host_thread threads[HOST_MAX_CPUS];
+    for (int i = 0; i < cpus; ++i) {
+        threads[i] = (struct host_thread) {.cpu = i, .task = task, .arg = arg};
+        CHECK(!pthread_create(&threads[i].thread, NULL, host_thread_main, &threads[i]));
+    }
+    for (int i = 0; i < cpus; ++i) {
+        pthread_join(threads[i].thread, NULL);
+    }
+}
+
+/**
+ * @brief create a heap of its own, apart from the default one behind kalloc.
+ */
+struct pmm_heap *host_heap_create(const size_t size) {
+    const uintptr_t start = (uintptr_t) host_map(size);
+    struct pmm_heap *h = pmm_heap_create(start, start + size);
+    CHECK(h);
+    return h;
+}
+
+uint64_t host_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief pages in free lists and fast lists of the default heap, by `pmm_sample`.
+ */
+size_t host_free_pages() {
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    size_t pages = 0;
+    for (size_t i = 0; i < LENGTH(sample.free_blocks); ++i) {
+        pages += (size_t) sample.free_blocks[i] << i;
+    }
+    for (int i = 0; i < FAST_ORDERS; ++i) {
+        pages += (size_t) sample.fast_blocks[i] << i;
+    }
+    return pages;
+}
+
+/**
+ * @brief xorshift64*, deterministic for a given seed and cheap enough for benchmarks.
+ */
+uint64_t host_random(uint64_t *state) {
+    uint64_t x = *state ? *state : 0x9e3779b97f4a7c15;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1d;
+}
+
+/**
+ * @brief write a snapshot of the given heap to the file at path, see `pmm_heap_snapshot`. NULL
+ * stands for the default heap, see `pmm_snapshot`.
+ * @return 0, if succeed; 1, if the file can't be written.
+ */
+int host_snapshot_write(struct pmm_heap *heap, const char *path) {
+    size_t len = heap ? pmm_heap_snapshot(heap, NULL, 0) : pmm_snapshot(NULL, 0);
+    uint8_t *buf;
+    for (;;) {
+        buf = malloc(len);
+        CHECK(buf);
+        // the heap may have grown in between, if other cpus are running
+        const size_t size = heap ? pmm_heap_snapshot(heap, buf, len) : pmm_snapshot(buf, len);
+        if (size <= len) {
+            len = size;
+            break;
+        }
+        free(buf);
+        len = size;
+    }
+    FILE *file = fopen(path, "wb");
+    int ret = !file || fwrite(buf, 1, len, file) != len;
+    if (file && fclose(file)) ret = 1;
+    free(buf);
+    return ret;
+}
+
+/**
+ * @brief read a snapshot written by `host_snapshot_write`, which is freed by the caller.
+ * @return the snapshot, whose size is stored in *len; NULL, if the file can't be read or isn't a
+ * snapshot of the current version.
+ */
+void *host_snapshot_read(const char *path, size_t *len) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *buf = size > 0 ? malloc(size) : NULL;
+    if (!buf || fread(buf, 1, size, file) != (size_t) size || (size_t) size < sizeof(struct pmm_snapshot_header)
+        || ((struct pmm_snapshot_header *) buf)->magic != PMM_SNAPSHOT_MAGIC
+        || ((struct pmm_snapshot_header *) buf)->version != PMM_SNAPSHOT_VERSION) {
+        free(buf);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *len = size;
+    return buf;
+}
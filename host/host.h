@@ -0,0 +1,47 @@
+/**
+ * the host build runs pmm.c as a plain process, for tests and benchmarks.
+ * `heap` is a region mapped by `host_init`, and every cpu is a thread whose cpu_current() is
+ * fixed when it's spawned by `host_run`. The main thread is cpu 0 unless `host_set_cpu` says
+ * otherwise.
+ */
+#ifndef PMM_HOST_H
+#define PMM_HOST_H
+
+#include "common.h"
+
+// abort the process with the location, unlike assert it's never compiled out.
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+// the cpus `host_run` can spawn at most
+#define HOST_MAX_CPUS 64
+
+typedef void (*host_task)(int cpu, void *arg);
+
+void host_init(int cpus, size_t heap_size);
+
+void host_exit();
+
+void host_set_cpu(int cpu);
+
+void host_run(host_task task, void *arg);
+
+struct pmm_heap *host_heap_create(size_t size);
+
+uint64_t host_clock_ns();
+
+uint64_t host_random(uint64_t *state);
+
+// pages in free lists and fast lists of the default heap
+size_t host_free_pages();
+
+int host_snapshot_write(struct pmm_heap *heap, const char *path);
+
+void *host_snapshot_read(const char *path, size_t *len);
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * kalloc_aligned serves any power-of-two alignment, by a slab cell if size and alignment fit a
+ * type, or else by a naturally aligned page block which takes just the rounded size.
+ */
+#include "host.h"
+
+static void test_invalid_alignments() {
+    host_init(1, 16 << 20);
+    CHECK(kalloc_aligned(64, 0) == NULL);
+    CHECK(kalloc_aligned(64, 48) == NULL);
+    CHECK(kalloc_aligned(MAX_REQUEST_MEM + 1, PAGE_SIZE) == NULL);
+    // beyond the largest block of this heap
+    CHECK(kalloc_aligned(64, (size_t) 1 << 40) == NULL);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_cells_fit_size_and_alignment() {
+    host_init(1, 16 << 20);
+    const size_t cases[][3] = {
+        // size, align, usable size
+        {24, 64, 64},
+        {100, 64, 128},
+        {1, 8, 8},
+        {8, 128, 128},
+    };
+    for (size_t i = 0; i < LENGTH(cases); ++i) {
+        void *p = kalloc_aligned(cases[i][0], cases[i][1]);
+        CHECK(p && (uintptr_t) p % cases[i][1] == 0);
+        CHECK(kalloc_usable_size(p) == cases[i][2]);
+        memset(p, 0xa5, cases[i][0]);
+        pmm->free(p);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_page_blocks_take_the_rounded_size() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    // above the fast list orders, so that free_pages drops by the block alone
+    const size_t size = (size_t) PAGE_SIZE << FAST_ORDERS;
+    const size_t before = test_heap->mem.free_pages;
+    void *p = pmm_heap_alloc_aligned(test_heap, size, size);
+    CHECK(p && (uintptr_t) p % size == 0);
+    CHECK(pmm_heap_usable_size(test_heap, p) == size);
+    CHECK(before - test_heap->mem.free_pages == size / PAGE_SIZE);
+    memset(p, 0xa5, size);
+
+    // whereas kalloc of the same size takes a block twice as big for MemMetaData and offset
+    void *q = pmm_heap_alloc(test_heap, size);
+    CHECK(q && (uintptr_t) q % size == 0);
+    CHECK(before - test_heap->mem.free_pages == 3 * size / PAGE_SIZE);
+
+    pmm_heap_free(test_heap, p);
+    pmm_heap_free(test_heap, q);
+    CHECK(test_heap->mem.free_pages == before);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_alignment_above_size() {
+    host_init(1, 16 << 20);
+    const size_t align = 1 << 20;
+    void *p = kalloc_aligned(100, align);
+    CHECK(p && (uintptr_t) p % align == 0);
+    CHECK(kalloc_usable_size(p) == align);
+    // between the largest type of slab and a page
+    void *q = kalloc_aligned(200, 256);
+    CHECK(q && (uintptr_t) q % 256 == 0);
+    CHECK(kalloc_usable_size(q) == PAGE_SIZE);
+    pmm->free(p);
+    pmm->free(q);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_random_requests() {
+    host_init(1, 64 << 20);
+    struct pmm_sample before, after;
+    pmm_sample(&before);
+    enum { N = 256 };
+    static struct {
+        uint8_t *ptr;
+        size_t size;
+    } live[N];
+    uint64_t seed = 1;
+    for (int step = 0; step < 4000; ++step) {
+        const int j = (int) (host_random(&seed) % N);
+        if (live[j].ptr) {
+            // nobody else has written into it
+            for (size_t k = 0; k < live[j].size; k += 61) CHECK(live[j].ptr[k] == (uint8_t) j);
+            pmm->free(live[j].ptr);
+        }
+        const size_t size = 1 + host_random(&seed) % (64 << 10);
+        const size_t align = (size_t) 1 << (host_random(&seed) % 18);
+        live[j].ptr = kalloc_aligned(size, align);
+        live[j].size = size;
+        CHECK(live[j].ptr && (uintptr_t) live[j].ptr % align == 0);
+        CHECK(kalloc_usable_size(live[j].ptr) >= size);
+        memset(live[j].ptr, j, size);
+    }
+    CHECK(pmm_check() == 0);
+    for (int j = 0; j < N; ++j) {
+        if (live[j].ptr) pmm->free(live[j].ptr);
+    }
+    pmm_sample(&after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_invalid_alignments();
+    test_cells_fit_size_and_alignment();
+    test_page_blocks_take_the_rounded_size();
+    test_alignment_above_size();
+    test_random_requests();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * an arena bumps objects out of page chunks and gives them back all at once.
+ */
+#include "host.h"
+
+static void test_objects_are_bumped() {
+    host_init(1, 64 << 20);
+    struct pmm_arena arena;
+    pmm_arena_init(&arena, 4 * PAGE_SIZE);
+    CHECK(arena.chunk_order == 15);
+
+    uint8_t *a = pmm_arena_alloc(&arena, 1);
+    uint8_t *b = pmm_arena_alloc(&arena, 40);
+    uint8_t *c = pmm_arena_alloc(&arena, 16);
+    CHECK(a && b && c);
+    CHECK((uintptr_t) a % ARENA_ALIGN == 0);
+    CHECK(b == a + ARENA_ALIGN && c == b + 48);
+    CHECK(arena.chunks && !arena.chunks->next);
+    pmm_arena_destroy(&arena);
+    CHECK(!arena.chunks);
+}
+
+static void test_chunks_are_added_as_needed() {
+    host_init(1, 64 << 20);
+    const size_t before = host_free_pages();
+    struct pmm_arena arena;
+    pmm_arena_init(&arena, PAGE_SIZE);
+
+    // a chunk holds less than a page worth of objects after its header
+    for (int i = 0; i < 4; ++i) {
+        uint8_t *p = pmm_arena_alloc(&arena, PAGE_SIZE / 2);
+        CHECK(p);
+        memset(p, i, PAGE_SIZE / 2);
+    }
+    int chunks = 0;
+    for (struct arena_chunk *chunk = arena.chunks; chunk; chunk = chunk->next) {
+        CHECK(chunk->order == 13 && chunk->top <= chunk->end);
+        chunks++;
+    }
+    CHECK(chunks == 4);
+
+    // an oversized object gets a chunk of its own, behind the one being bumped
+    struct arena_chunk *head = arena.chunks;
+    uint8_t *big = pmm_arena_alloc(&arena, 5 * PAGE_SIZE);
+    CHECK(big);
+    memset(big, 0xff, 5 * PAGE_SIZE);
+    CHECK(arena.chunks == head && head->next->order == 16);
+    CHECK(host_free_pages() == before - 4 - 8);
+
+    pmm_arena_destroy(&arena);
+    CHECK(host_free_pages() == before);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_reset_keeps_the_newest_chunk() {
+    host_init(1, 64 << 20);
+    const size_t before = host_free_pages();
+    struct pmm_arena arena;
+    pmm_arena_init(&arena, PAGE_SIZE);
+    for (int i = 0; i < 10; ++i) {
+        CHECK(pmm_arena_alloc(&arena, 3000));
+    }
+    struct arena_chunk *newest = arena.chunks;
+    pmm_arena_reset(&arena);
+    CHECK(arena.chunks == newest && !newest->next);
+    CHECK(host_free_pages() == before - 1);
+
+    // the kept chunk is rewound
+    uint8_t *p = pmm_arena_alloc(&arena, 3000);
+    CHECK(p == (uint8_t *) ROUNDUP((uintptr_t) newest + sizeof(struct arena_chunk), ARENA_ALIGN));
+    pmm_arena_destroy(&arena);
+    CHECK(host_free_pages() == before);
+
+    // and the arena can be used again
+    CHECK(pmm_arena_alloc(&arena, 8));
+    pmm_arena_destroy(&arena);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_objects_are_bumped();
+    test_chunks_are_added_as_needed();
+    test_reset_keeps_the_newest_chunk();
+    host_exit();
+    return 0;
+}
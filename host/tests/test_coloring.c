@@ -0,0 +1,48 @@
+/**
+ * slabs of a type are colored, so that their first cells sit at different offsets in a page
+ * rather than competing for the same cache sets, see `slab_request_mem`.
+ */
+#include "host.h"
+
+static void test_first_cells_rotate(const int typeIndex) {
+    host_init(1, 64 << 20);
+    struct pmm_heap *h = host_heap_create(16 << 20);
+    void *p = pmm_heap_alloc(h, SLAB_CATEGORY[typeIndex]);
+    CHECK(p);
+
+    SlabMetaData *sentinel = &h->managers[0].sentinels[0][typeIndex];
+    const size_t type_size = SLAB_CATEGORY[typeIndex];
+    const size_t step = type_size > CACHE_LINE_SIZE ? type_size : CACHE_LINE_SIZE;
+    // a slab takes a whole page block
+    size_t slab_size = PAGE_SIZE;
+    while (slab_size < SLAB_INIT_PAGES_PER_TURN[typeIndex] * PAGE_SIZE) slab_size <<= 1;
+    size_t uncolored = 0; // the offset of cells of color 0
+    int slabs = 0, seen = 0;
+    for (SlabMetaData *meta = sentinel->next; meta != sentinel; meta = meta->next) {
+        const uintptr_t first = (uintptr_t) meta + meta->offset;
+        CHECK(first % type_size == 0);
+        // cells stay after the bitmaps and within the slab
+        CHECK(first >= (uintptr_t) (meta->p_bitmap + meta->groups));
+        CHECK(first + meta->remaining * type_size <= (uintptr_t) meta + slab_size - meta->color * step);
+        if (meta->color == 0) uncolored = meta->offset;
+        seen |= 1 << meta->color;
+        slabs++;
+    }
+    CHECK(slabs == SLAB_INIT_TURNS[typeIndex]);
+    CHECK(uncolored);
+    // the initial slabs take consecutive colors, and each color moves the cells by a step
+    CHECK(seen == (1 << slabs) - 1);
+    for (SlabMetaData *meta = sentinel->next; meta != sentinel; meta = meta->next) {
+        CHECK(meta->offset == uncolored - meta->color * step);
+    }
+    CHECK(sentinel->color == slabs);
+    pmm_heap_free(h, p);
+    CHECK(pmm_heap_check(h) == 0);
+}
+
+int main() {
+    test_first_cells_rotate(2);
+    test_first_cells_rotate(4);
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * kfree_deferred frees a pointer only once every cpu has passed a quiescent state after it
+ * was queued, and a pointer queued twice is freed once.
+ */
+#include "host.h"
+
+static int used_cells() {
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    int used = 0;
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        used += sample.used_cells[i];
+    }
+    return used;
+}
+
+static void test_single_cpu() {
+    host_init(1, 64 << 20);
+    void *p = pmm->alloc(32);
+    void *block = pmm->alloc(3 * PAGE_SIZE);
+    CHECK(p && block);
+    kfree_deferred(p);
+    kfree_deferred(block);
+    CHECK(used_cells() == 1);
+    // draining alone doesn't end a grace period
+    pmm_drain_deferred();
+    CHECK(used_cells() == 1);
+
+    struct pmm_sample before, after;
+    pmm_sample(&before);
+    pmm_quiescent();
+    CHECK(used_cells() == 0);
+    pmm_sample(&after);
+    CHECK(after.largest_order >= before.largest_order);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_every_cpu_must_be_quiescent() {
+    host_init(3, 64 << 20);
+    void *p = pmm->alloc(64);
+    kfree_deferred(p);
+    pmm_quiescent();
+    host_set_cpu(1);
+    pmm_quiescent();
+    host_set_cpu(0);
+    pmm_quiescent();
+    // cpu 2 may still be reading it
+    CHECK(used_cells() == 1);
+
+    host_set_cpu(2);
+    pmm_idle();
+    host_set_cpu(0);
+    CHECK(used_cells() == 1);
+    // epochs have moved on, so every cpu has to report once more
+    for (int cpu = 0; cpu < 3; ++cpu) {
+        host_set_cpu(cpu);
+        pmm_quiescent();
+    }
+    host_set_cpu(0);
+    pmm_quiescent();
+    CHECK(used_cells() == 0);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_twice_queued_is_freed_once() {
+    host_init(1, 64 << 20);
+    void *p = pmm->alloc(16);
+    void *page = pmm_alloc_pages(13);
+    void *block = pmm->alloc(2 * PAGE_SIZE);
+    kfree_deferred(p);
+    kfree_deferred(p);
+    kfree_deferred(page);
+    kfree_deferred(page);
+    kfree_deferred(block);
+    kfree_deferred(block);
+    pmm_quiescent();
+    CHECK(used_cells() == 0);
+    // its bit would have been set again by the second release
+    void *a = pmm->alloc(16), *b = pmm->alloc(16);
+    CHECK(a == p && b != p);
+    CHECK(used_cells() == 2);
+    pmm->free(a);
+    pmm->free(b);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_full_queue_waits_for_a_grace_period() {
+    host_init(1, 64 << 20);
+    enum { N = 3 * DEFERRED_CAPACITY };
+    // nothing expires before the first quiescent state, so every pointer stays queued up to the capacity
+    for (int i = 0; i < N; ++i) {
+        void *p = pmm->alloc(8);
+        CHECK(p);
+        kfree_deferred(p);
+        CHECK(used_cells() <= DEFERRED_CAPACITY);
+    }
+    pmm_quiescent();
+    CHECK(used_cells() == 0);
+    CHECK(pmm_check() == 0);
+}
+
+#define ROUNDS 2000
+
+static void free_while_others_do(const int cpu, void *arg) {
+    int *done = arg;
+    uint64_t seed = cpu + 1;
+    for (int i = 0; i < ROUNDS; ++i) {
+        const size_t size = host_random(&seed) % 256 + 1;
+        void *p = pmm->alloc(size);
+        CHECK(p);
+        memset(p, cpu, size);
+        kfree_deferred(p);
+        if (i % 16 == 0) pmm_quiescent();
+    }
+    // go idle, others may be waiting for this cpu to pass a quiescent state
+    __atomic_fetch_add(done, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(done, __ATOMIC_SEQ_CST) < cpu_count()) {
+        pmm_idle();
+        yield();
+    }
+}
+
+static void test_cpus_at_once() {
+    host_init(4, 64 << 20);
+    int done = 0;
+    host_run(free_while_others_do, &done);
+    for (int round = 0; round < 3; ++round) {
+        for (int cpu = 0; cpu < 4; ++cpu) {
+            host_set_cpu(cpu);
+            pmm_quiescent();
+        }
+    }
+    host_set_cpu(0);
+    CHECK(used_cells() == 0);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_single_cpu();
+    test_every_cpu_must_be_quiescent();
+    test_twice_queued_is_freed_once();
+    test_full_queue_waits_for_a_grace_period();
+    test_cpus_at_once();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * the smallest orders are cached in lock-free fast lists, which serve slabs as well as page
+ * blocks, and both ways of giving a page back agree on registry.
+ */
+#include "host.h"
+
+static void test_slabs_grow_from_fast_lists() {
+    host_init(1, 64 << 20);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    CHECK(sample.fast_blocks[0] == 0 && sample.fast_blocks[1] == 0);
+
+    // fill the initial slab, the first growth takes a page or two
+    static void *cells[1 << 14];
+    int n = 0;
+    do {
+        cells[n] = pmm->alloc(8);
+        CHECK(cells[n]);
+        pmm_sample(&sample);
+        n++;
+    } while (sample.slabs[0] == SLAB_INIT_TURNS[0] && n < LENGTH(cells));
+    CHECK(sample.slabs[0] == SLAB_INIT_TURNS[0] + 1);
+    // the rest of the refill batch is cached, none of it was flushed back
+    CHECK(sample.fast_blocks[0] + sample.fast_blocks[1] == FAST_LIST_BATCH - 1);
+
+    // once empty, the grown slab goes back as a page block
+    for (int i = 0; i < n; ++i) {
+        pmm->free(cells[i]);
+    }
+    pmm_sample(&sample);
+    CHECK(sample.slabs[0] == SLAB_INIT_TURNS[0]);
+    CHECK(sample.fast_blocks[0] + sample.fast_blocks[1] == FAST_LIST_BATCH);
+    CHECK(pmm_check() == 0);
+}
+
+static int by_address(const void *a, const void *b) {
+    const uintptr_t x = *(const uintptr_t *) a, y = *(const uintptr_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_refill_doesnt_flush_its_own_batch() {
+    host_init(1, 4 << 20);
+    // take every page, so that free lists are empty
+    static void *pages[1 << 10];
+    int n = 0;
+    while ((pages[n] = pmm_alloc_pages(13))) {
+        n++;
+    }
+    CHECK(n > 2 * FAST_LIST_BATCH);
+    qsort(pages, n, sizeof(void *), by_address);
+    // give back pairs of buddies, which stay apart in fast_list
+    int freed = 0;
+    for (int i = 0; i + 1 < n && freed < 8; ++i) {
+        if ((uintptr_t) pages[i] % (2 * PAGE_SIZE) == 0 && pages[i + 1] == (uint8_t *) pages[i] + PAGE_SIZE) {
+            CHECK(pmm_free_pages(pages[i], 13) == 0);
+            CHECK(pmm_free_pages(pages[i + 1], 13) == 0);
+            pages[i] = pages[i + 1] = NULL;
+            freed += 2;
+        }
+    }
+    CHECK(freed == 8);
+
+    // only the flush for the first block is allowed, which merges the pairs
+    void *p = pmm_alloc_pages(14);
+    CHECK(p);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    CHECK(sample.fast_blocks[0] == 0);
+    CHECK(sample.fast_blocks[1] + sample.free_blocks[1] == 3);
+    CHECK(pmm_free_pages(p, 14) == 0);
+    for (int i = 0; i < n; ++i) {
+        if (pages[i]) CHECK(pmm_free_pages(pages[i], 13) == 0);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+#define RACING_PAGES 512
+
+struct race {
+    void *pages[RACING_PAGES];
+    int freed;
+};
+
+static void free_every_page(const int cpu, void *arg) {
+    struct race *race = arg;
+    for (int i = 0; i < RACING_PAGES; ++i) {
+        const int k = cpu % 2 ? i : RACING_PAGES - 1 - i;
+        if (!pmm_free_pages(race->pages[k], 13)) __atomic_fetch_add(&race->freed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void test_racing_frees_free_once() {
+    host_init(4, 64 << 20);
+    for (int round = 0; round < 8; ++round) {
+        static struct race race;
+        race.freed = 0;
+        for (int i = 0; i < RACING_PAGES; ++i) {
+            race.pages[i] = pmm_alloc_pages(13);
+            CHECK(race.pages[i]);
+        }
+        // more pages than fast_list holds, so both the lock-free and the locked path are taken
+        host_run(free_every_page, &race);
+        CHECK(race.freed == RACING_PAGES);
+        CHECK(pmm_check() == 0);
+    }
+}
+
+static void churn(const int cpu, void *arg) {
+    uint64_t seed = cpu * 7 + 1;
+    void *kept[64] = {0};
+    for (int i = 0; i < 20000; ++i) {
+        const int k = (int) (host_random(&seed) % LENGTH(kept));
+        if (kept[k]) {
+            pmm->free(kept[k]);
+            kept[k] = NULL;
+        } else {
+            const size_t size = host_random(&seed) % 2 ? host_random(&seed) % 128 + 1 : PAGE_SIZE << (host_random(&seed) % 2);
+            kept[k] = size > 128 ? pmm_alloc_pages(size == PAGE_SIZE ? 13 : 14) : pmm->alloc(size);
+            CHECK(kept[k]);
+            memset(kept[k], cpu, size);
+        }
+    }
+    for (int k = 0; k < LENGTH(kept); ++k) {
+        pmm->free(kept[k]);
+    }
+}
+
+static void test_slabs_and_pages_at_once() {
+    host_init(4, 64 << 20);
+    host_run(churn, NULL);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        CHECK(sample.used_cells[i] == 0);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_slabs_grow_from_fast_lists();
+    test_refill_doesnt_flush_its_own_batch();
+    test_racing_frees_free_once();
+    test_slabs_and_pages_at_once();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * in embedded freelist mode, free cells are chained through their first word, and the cell
+ * freed last is handed out first. Built with PMM_SLAB_FREELIST=1.
+ */
+#include "host.h"
+
+static void test_every_type_is_in_freelist_mode() {
+    host_init(1, 64 << 20);
+    struct pmm_heap *h = host_heap_create(16 << 20);
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        CHECK(h->managers[0].sentinels[0][i].freelist);
+    }
+}
+
+static void test_cells_are_reused_in_lifo_order() {
+    host_init(1, 64 << 20);
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        const size_t size = SLAB_CATEGORY[i];
+        void *a = pmm->alloc(size), *b = pmm->alloc(size), *c = pmm->alloc(size);
+        CHECK(a && b && c && a != b && b != c && a != c);
+        CHECK((uintptr_t) a % size == 0 && kalloc_usable_size(a) == size);
+        pmm->free(a);
+        pmm->free(c);
+        CHECK(pmm->alloc(size) == c);
+        CHECK(pmm->alloc(size) == a);
+        pmm->free(a);
+        pmm->free(b);
+        pmm->free(c);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_cells_are_distinct() {
+    host_init(1, 64 << 20);
+    enum { N = 4000 };
+    static uint8_t *cells[N];
+    for (int i = 0; i < N; ++i) {
+        cells[i] = pmm->alloc(SLAB_CATEGORY[i % SLAB_TYPES]);
+        CHECK(cells[i]);
+        memset(cells[i], i, SLAB_CATEGORY[i % SLAB_TYPES]);
+    }
+    CHECK(pmm_check() == 0);
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < SLAB_CATEGORY[i % SLAB_TYPES]; ++j) {
+            CHECK(cells[i][j] == (uint8_t) i);
+        }
+    }
+    // every other one, so that the freelists interleave
+    for (int i = 0; i < N; i += 2) {
+        pmm->free(cells[i]);
+    }
+    CHECK(pmm_check() == 0);
+    for (int i = 1; i < N; i += 2) {
+        pmm->free(cells[i]);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_double_free_is_ignored() {
+    host_init(1, 64 << 20);
+    void *a = pmm->alloc(32);
+    pmm->free(a);
+    pmm->free(a);
+    // a is on the freelist once
+    void *b = pmm->alloc(32), *c = pmm->alloc(32);
+    CHECK(b == a && c != a);
+    pmm->free(b);
+    pmm->free(c);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_every_type_is_in_freelist_mode();
+    test_cells_are_reused_in_lifo_order();
+    test_cells_are_distinct();
+    test_double_free_is_ignored();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * slabs grow by up to SLAB_MAX_GROW_PAGES pages under sustained demand, and shrink back as they
+ * turn out to be empty, see `private__slab_grow`.
+ */
+#include "host.h"
+
+#define TYPE 4
+
+static int slab_pages(struct pmm_heap *h, SlabMetaData *meta) {
+    const uint8_t registered = h->mem.registry[((uintptr_t) meta - h->mem.start) / PAGE_SIZE];
+    CHECK(registered & REGISTRY_SLAB);
+    return 1 << ((registered & ~REGISTRY_SLAB) - 13);
+}
+
+static void test_sustained_demand_doubles() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *h = host_heap_create(32 << 20);
+    SlabMetaData *sentinel = &h->managers[0].sentinels[0][TYPE];
+    static void *cells[1 << 14];
+    int n = 0;
+    cells[n++] = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+    SlabMetaData *newest = sentinel->prev;
+
+    // the initial slabs were taken at once, so the first growth is a single page
+    const int expected[] = {1, 2, 4, 8, 8};
+    for (int i = 0; i < LENGTH(expected); ++i) {
+        while (sentinel->prev == newest) {
+            CHECK(n < LENGTH(cells));
+            cells[n++] = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+            CHECK(cells[n - 1]);
+        }
+        newest = sentinel->prev;
+        CHECK(newest->status == REUSABLE && newest->sentinel == sentinel);
+        CHECK(slab_pages(h, newest) == expected[i]);
+    }
+    CHECK(pmm_heap_check(h) == 0);
+
+    // every empty slab halves the next growth, and gives its pages back
+    for (int i = n - 1; i >= 0; --i) {
+        pmm_heap_free(h, cells[i]);
+    }
+    CHECK(sentinel->grow_pages == 1);
+    int slabs = 0;
+    for (SlabMetaData *p = sentinel->next; p != sentinel; p = p->next) {
+        CHECK(p->status == INITIAL && p->sentinel == sentinel);
+        slabs++;
+    }
+    CHECK(slabs == SLAB_INIT_TURNS[TYPE]);
+    CHECK(pmm_heap_check(h) == 0);
+}
+
+static void test_churn_doesnt_grow() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *h = host_heap_create(32 << 20);
+    SlabMetaData *sentinel = &h->managers[0].sentinels[0][TYPE];
+    static void *cells[1 << 12];
+    int n = 0;
+    // fill the initial slabs
+    cells[n++] = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+    SlabMetaData *initial = sentinel->prev;
+    while (sentinel->prev == initial) {
+        cells[n++] = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+    }
+    CHECK(slab_pages(h, sentinel->prev) == 1);
+    // a lot of allocations and frees before the next growth keep it at a page
+    for (int round = 0; round < 1000; ++round) {
+        void *p = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+        pmm_heap_free(h, p);
+    }
+    SlabMetaData *newest = sentinel->prev;
+    while (sentinel->prev == newest) {
+        cells[n++] = pmm_heap_alloc(h, SLAB_CATEGORY[TYPE]);
+    }
+    CHECK(slab_pages(h, sentinel->prev) == 1);
+    for (int i = 0; i < n; ++i) {
+        pmm_heap_free(h, cells[i]);
+    }
+    CHECK(pmm_heap_check(h) == 0);
+}
+
+int main() {
+    test_sustained_demand_doubles();
+    test_churn_doesnt_grow();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * built against pmm_host_hardened (-DPMM_HARDENED): requests are padded by PMM_REDZONE_MIN, so
+ * that overflows of a single byte are caught as violations even for exact sizes, as are
+ * underflows and double frees. Freed space is poisoned and held in quarantine, and
+ * kfree_deferred, kalloc_aligned, kzalloc and arenas go through the same checks.
+ */
+#include "host.h"
+
+static uint64_t violations(struct pmm_heap *test_heap) {
+    struct pmm_hardened_stats stats;
+    pmm_heap_hardened_stats(test_heap, &stats);
+    return stats.violations;
+}
+
+static uint8_t registry_of(struct pmm_heap *test_heap, const void *ptr) {
+    return test_heap->mem.registry[((uintptr_t) ptr - test_heap->mem.start) >> test_heap->mem.base_order];
+}
+
+static void test_sizes_are_padded() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    // the largest type of slab takes requests up to PMM_REDZONE_MIN short of it
+    const size_t largest = SLAB_CATEGORY[SLAB_TYPES - 1];
+    void *cell = pmm_heap_alloc(test_heap, largest - PMM_REDZONE_MIN);
+    CHECK(cell && registry_of(test_heap, cell) & REGISTRY_SLAB);
+    CHECK(pmm_heap_usable_size(test_heap, cell) == largest - PMM_REDZONE_MIN);
+    void *above = pmm_heap_alloc(test_heap, largest);
+    CHECK(above && !(registry_of(test_heap, above) & REGISTRY_SLAB));
+
+    // and a page takes a block of four pages, rather than two without hardened mode
+    const size_t before = test_heap->mem.free_pages;
+    void *block = pmm_heap_alloc(test_heap, PAGE_SIZE);
+    CHECK(block && before - test_heap->mem.free_pages == 4);
+    CHECK(pmm_heap_usable_size(test_heap, block) == PAGE_SIZE);
+
+    void *small = pmm_heap_alloc(test_heap, 100);
+    CHECK(pmm_heap_usable_size(test_heap, small) == 100);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_overflows_are_caught() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    uint8_t *cell = pmm_heap_alloc(test_heap, 100);
+    uint8_t *block = pmm_heap_alloc(test_heap, 10000);
+    CHECK(cell && block);
+    memset(cell, 1, 100);
+    memset(block, 1, 10000);
+    CHECK(pmm_heap_check(test_heap) == 0);
+
+    cell[100] = 0;
+    block[10000] = 0;
+    CHECK(pmm_heap_check(test_heap) == 1);
+    pmm_heap_free(test_heap, cell);
+    pmm_heap_free(test_heap, block);
+    CHECK(violations(test_heap) == 2);
+    // neither is reused, and what's left is consistent
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_exact_sizes_overflow_into_redzones() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    const size_t sizes[] = {8, 64, SLAB_CATEGORY[SLAB_TYPES - 1], PAGE_SIZE, 4 * PAGE_SIZE};
+    for (size_t i = 0; i < LENGTH(sizes); ++i) {
+        uint8_t *p = pmm_heap_alloc(test_heap, sizes[i]);
+        CHECK(p);
+        memset(p, 1, sizes[i]);
+        CHECK(pmm_heap_check(test_heap) == 0);
+        p[sizes[i]] = 0;
+        CHECK(pmm_heap_check(test_heap) == 1);
+        pmm_heap_free(test_heap, p);
+        CHECK(violations(test_heap) == i + 1);
+        CHECK(pmm_heap_check(test_heap) == 0);
+    }
+}
+
+static void test_underflows_hit_guards() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    // the first cell of a fresh slab
+    uint8_t *cell = pmm_heap_alloc(test_heap, 64);
+    CHECK(cell);
+    const SlabMetaData *meta = (SlabMetaData *) ROUNDDOWN((uintptr_t) cell,
+                                                          (uintptr_t) 1 << (registry_of(test_heap, cell) & ~REGISTRY_SLAB));
+    CHECK((uintptr_t) cell == (uintptr_t) meta + meta->offset);
+    cell[-1] = 0;
+    CHECK(pmm_heap_check(test_heap) == 1);
+    cell[-1] = PMM_REDZONE_BYTE;
+    CHECK(pmm_heap_check(test_heap) == 0);
+
+    // the guard of a block lies ahead of its header and offset
+    uint8_t *block = pmm_heap_alloc(test_heap, 10000);
+    CHECK(block);
+    uint8_t *guard = block - sizeof(size_t) - sizeof(struct redzone_header) - 1;
+    *guard = 0;
+    CHECK(pmm_heap_check(test_heap) == 1);
+    pmm_heap_free(test_heap, block);
+    CHECK(violations(test_heap) == 1);
+    *guard = PMM_REDZONE_BYTE;
+    CHECK(pmm_heap_check(test_heap) == 0);
+
+    // the next cell runs into the redzone of the cell ahead, padded to a cell of 128 bytes
+    uint8_t *next = pmm_heap_alloc(test_heap, 64);
+    CHECK(next == cell + 128);
+    next[-1] = 0;
+    CHECK(pmm_heap_check(test_heap) == 1);
+    pmm_heap_free(test_heap, cell);
+    CHECK(violations(test_heap) == 2);
+
+    // and a block by a single byte breaks the high byte of its offset
+    block = pmm_heap_alloc(test_heap, 10000);
+    CHECK(block);
+    block[-1] = 1;
+    pmm_heap_free(test_heap, block);
+    CHECK(violations(test_heap) == 3);
+}
+
+static void test_double_frees_are_caught() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    void *cell = pmm_heap_alloc(test_heap, 32);
+    void *block = pmm_heap_alloc(test_heap, 3 * PAGE_SIZE);
+    CHECK(cell && block);
+    pmm_heap_free(test_heap, cell);
+    pmm_heap_free(test_heap, block);
+    CHECK(violations(test_heap) == 0);
+    pmm_heap_free(test_heap, cell);
+    pmm_heap_free(test_heap, block);
+    CHECK(violations(test_heap) == 2);
+    // a cell that has never been allocated
+    pmm_heap_free(test_heap, (uint8_t *) cell + 32);
+    CHECK(violations(test_heap) == 3);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_quarantine_poisons_and_delays_reuse() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    uint8_t *freed = pmm_heap_alloc(test_heap, 48);
+    CHECK(freed);
+    memset(freed, 1, 48);
+    pmm_heap_free(test_heap, freed);
+    for (int i = 0; i < 48; ++i) CHECK(freed[i] == PMM_POISON_BYTE);
+
+    struct pmm_hardened_stats stats;
+    pmm_heap_hardened_stats(test_heap, &stats);
+    CHECK(stats.quarantined == 1 && stats.quarantine_bytes == 64 && stats.poisoned_bytes == 64);
+    for (int i = 0; i < PMM_QUARANTINE - 1; ++i) {
+        void *p = pmm_heap_alloc(test_heap, 48);
+        CHECK(p != freed);
+        pmm_heap_free(test_heap, p);
+    }
+    // reclaim gives back whatever is held
+    pmm_heap_reclaim(test_heap);
+    pmm_heap_hardened_stats(test_heap, &stats);
+    CHECK(stats.quarantine_bytes == 0);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_aligned_cells_have_redzones() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *test_heap = host_heap_create(16 << 20);
+    uint8_t *p = pmm_heap_alloc_aligned(test_heap, 20, 64);
+    CHECK(p && (uintptr_t) p % 64 == 0);
+    CHECK(pmm_heap_usable_size(test_heap, p) == 20);
+    p[20] = 0;
+    pmm_heap_free(test_heap, p);
+    CHECK(violations(test_heap) == 1);
+
+    // and so do pages, which are blocks from `mem_allocate` rather than page blocks
+    uint8_t *page = pmm_heap_alloc_aligned(test_heap, PAGE_SIZE, PAGE_SIZE);
+    CHECK(page && (uintptr_t) page % PAGE_SIZE == 0);
+    CHECK(!(registry_of(test_heap, page) & REGISTRY_PAGE));
+    CHECK(pmm_heap_usable_size(test_heap, page) == PAGE_SIZE);
+    page[PAGE_SIZE] = 0;
+    pmm_heap_free(test_heap, page);
+    CHECK(violations(test_heap) == 2);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_kzalloc_has_redzones() {
+    host_init(1, 64 << 20);
+    pmm_refill_zero_pool();
+    uint8_t *p = kzalloc(PAGE_SIZE);
+    CHECK(p);
+    for (size_t i = 0; i < PAGE_SIZE; ++i) CHECK(p[i] == 0);
+    CHECK(kalloc_usable_size(p) == PAGE_SIZE);
+    p[PAGE_SIZE] = 0;
+    pmm->free(p);
+    struct pmm_hardened_stats stats;
+    pmm_hardened_stats(&stats);
+    CHECK(stats.violations == 1);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_deferred_frees_are_checked() {
+    host_init(1, 64 << 20);
+    uint8_t *p = pmm->alloc(40);
+    CHECK(p);
+    kfree_deferred(p);
+    kfree_deferred(p);
+    pmm_quiescent();
+    // one goes to quarantine, the other is a double free
+    struct pmm_hardened_stats stats;
+    pmm_hardened_stats(&stats);
+    CHECK(stats.quarantined == 1 && stats.violations == 1);
+    CHECK(p[0] == PMM_POISON_BYTE);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_arenas_are_poisoned() {
+    host_init(1, 64 << 20);
+    struct pmm_arena arena;
+    pmm_arena_init(&arena, PAGE_SIZE);
+    uint8_t *p = pmm_arena_alloc(&arena, 100);
+    CHECK(p);
+    memset(p, 1, 100);
+    pmm_arena_reset(&arena);
+    // the kept chunk is still mapped
+    for (int i = 0; i < 100; ++i) CHECK(p[i] == PMM_POISON_BYTE);
+    pmm_arena_destroy(&arena);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_sizes_are_padded();
+    test_overflows_are_caught();
+    test_exact_sizes_overflow_into_redzones();
+    test_underflows_hit_guards();
+    test_double_frees_are_caught();
+    test_quarantine_poisons_and_delays_reuse();
+    test_aligned_cells_have_redzones();
+    test_kzalloc_has_redzones();
+    test_deferred_frees_are_checked();
+    test_arenas_are_poisoned();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * heaps are independent instances: each hands out memory of its own range only, and gives
+ * back only what it has handed out.
+ */
+#include "host.h"
+
+static int in_heap(struct pmm_heap *h, void *p) {
+    return (uintptr_t) p >= h->mem.start && (uintptr_t) p < h->mem.end;
+}
+
+static int used_cells(struct pmm_heap *h) {
+    struct pmm_sample sample;
+    pmm_heap_sample(h, &sample);
+    int used = 0;
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        used += sample.used_cells[i];
+    }
+    return used;
+}
+
+static void test_heaps_are_disjoint() {
+    host_init(2, 16 << 20);
+    struct pmm_heap *low = host_heap_create(8 << 20), *high = host_heap_create(32 << 20);
+    const size_t sizes[] = {8, 128, 1000, PAGE_SIZE, 5 * PAGE_SIZE, 1 << 20};
+    for (size_t i = 0; i < LENGTH(sizes); ++i) {
+        void *a = pmm_heap_alloc(low, sizes[i]), *b = pmm_heap_alloc(high, sizes[i]);
+        CHECK(in_heap(low, a) && in_heap(high, b));
+        CHECK(pmm_heap_usable_size(low, a) >= sizes[i] && pmm_heap_usable_size(high, b) >= sizes[i]);
+        memset(a, 1, sizes[i]);
+        memset(b, 2, sizes[i]);
+        pmm_heap_free(low, a);
+        pmm_heap_free(high, b);
+    }
+    CHECK(used_cells(low) == 0 && used_cells(high) == 0);
+    CHECK(pmm_heap_check(low) == 0 && pmm_heap_check(high) == 0);
+}
+
+static void test_foreign_pointers_are_ignored() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *a = host_heap_create(8 << 20), *b = host_heap_create(8 << 20);
+    void *cell = pmm_heap_alloc(a, 32);
+    void *block = pmm_heap_alloc(a, 3 * PAGE_SIZE);
+    pmm_heap_free(b, cell);
+    pmm_heap_free(b, block);
+    CHECK(used_cells(a) == 1);
+    CHECK(pmm_heap_usable_size(b, cell) == 0);
+    // nor does the default heap take them
+    pmm->free(cell);
+    kfree_deferred(cell);
+    kfree_deferred(NULL);
+    pmm_quiescent();
+    CHECK(used_cells(a) == 1);
+    pmm_heap_free(a, cell);
+    pmm_heap_free(a, block);
+    CHECK(used_cells(a) == 0);
+    CHECK(pmm_heap_check(a) == 0 && pmm_heap_check(b) == 0 && pmm_check() == 0);
+}
+
+static void test_exhaustion_stays_in_its_heap() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *small = host_heap_create(2 << 20), *big = host_heap_create(16 << 20);
+    int blocks = 0;
+    while (pmm_heap_alloc(small, PAGE_SIZE)) {
+        blocks++;
+    }
+    CHECK(blocks > 0 && blocks < 256);
+    CHECK(!pmm_heap_alloc(small, 8 * PAGE_SIZE));
+    CHECK(pmm_heap_alloc(big, 1 << 20));
+    CHECK(pmm->alloc(1 << 20));
+}
+
+static void test_small_regions_are_untouched() {
+    host_init(4, 16 << 20);
+    // far smaller than the heap and slab managers of 4 cpus
+    static uint8_t region[64 << 10];
+    memset(region, 0xcc, sizeof(region));
+    CHECK(pmm_heap_create((uintptr_t) region, (uintptr_t) region + (16 << 10)) == NULL);
+    CHECK(pmm_heap_create((uintptr_t) region + 64, (uintptr_t) region) == NULL);
+    for (size_t i = 0; i < sizeof(region); ++i) {
+        CHECK(region[i] == 0xcc);
+    }
+}
+
+int main() {
+    test_heaps_are_disjoint();
+    test_foreign_pointers_are_ignored();
+    test_exhaustion_stays_in_its_heap();
+    test_small_regions_are_untouched();
+    host_exit();
+    return 0;
+}
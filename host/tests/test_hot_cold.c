@@ -0,0 +1,141 @@
+/**
+ * with PLACEMENT_LIFO, blocks freed as they are go to the hot end of their free list, i.e. the
+ * head, and merged blocks and halves split off go to the cold end, i.e. the tail. PMM_COLD
+ * allocations are served from the cold end, everything else from the hot end.
+ */
+#include "host.h"
+
+// blocks above the fast list orders, so that only free lists are involved
+#define ORDER 15
+// kalloc of SIZE takes a block of ORDER, including MemMetaData and offset
+#define SIZE (12 << 10)
+#define N 16
+
+static int compare(const void *a, const void *b) {
+    const uintptr_t x = *(const uintptr_t *) a, y = *(const uintptr_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static uintptr_t block_of(const void *ptr) {
+    return ROUNDDOWN((uintptr_t) ptr, (uintptr_t) 1 << ORDER);
+}
+
+static int index_of(struct pmm_heap *heap, const int order) {
+    return order - heap->mem.base_order;
+}
+
+/**
+ * @brief allocate N blocks, sorted by address, and free four of them, none of which is the
+ * buddy of another, so that none of them is merged.
+ * @return the freed blocks in the order they were freed.
+ */
+static void scatter(struct pmm_heap *heap, void *blocks[N], void *freed[4]) {
+    for (int i = 0; i < N; ++i) {
+        blocks[i] = pmm_heap_alloc(heap, SIZE);
+        CHECK(blocks[i]);
+    }
+    qsort(blocks, N, sizeof(blocks[0]), compare);
+    const int order[4] = {13, 5, 1, 9};
+    for (int i = 0; i < 4; ++i) {
+        freed[i] = blocks[order[i]];
+        blocks[order[i]] = NULL;
+        pmm_heap_free(heap, freed[i]);
+    }
+}
+
+static void test_frees_go_to_the_hot_end() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    void *blocks[N], *freed[4];
+    scatter(heap, blocks, freed);
+    MemMetaData *p = heap->mem.free_list[index_of(heap, ORDER)];
+    for (int i = 3; i >= 0; --i, p = p->next) {
+        CHECK((uintptr_t) p == block_of(freed[i]));
+    }
+    // and an ordinary allocation takes them back, the last freed first
+    CHECK(block_of(pmm_heap_alloc(heap, SIZE)) == block_of(freed[3]));
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_cold_allocations_take_the_tail() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    void *blocks[N], *freed[4];
+    scatter(heap, blocks, freed);
+    const int index = index_of(heap, ORDER);
+    const uintptr_t hot = (uintptr_t) heap->mem.free_list[index];
+    const uintptr_t cold = (uintptr_t) heap->mem.free_tail[index];
+    CHECK(hot != cold);
+    CHECK(block_of(pmm_heap_alloc_flags(heap, SIZE, PMM_COLD)) == cold);
+    CHECK(block_of(pmm_heap_alloc(heap, SIZE)) == hot);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_merged_blocks_go_to_the_cold_end() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    void *blocks[N], *freed[4];
+    scatter(heap, blocks, freed);
+    // the buddy of a freed block is still allocated, give it back as well
+    const uintptr_t buddy = block_of(freed[0]) ^ ((uintptr_t) 1 << ORDER);
+    int found = 0;
+    for (int i = 0; i < N; ++i) {
+        if (blocks[i] && block_of(blocks[i]) == buddy) {
+            pmm_heap_free(heap, blocks[i]);
+            found = 1;
+        }
+    }
+    CHECK(found);
+    // the merged block is at the tail of whichever order it has reached
+    int merged = 0;
+    for (int order = ORDER + 1; order <= heap->mem.max_order; ++order) {
+        const uintptr_t addr = ROUNDDOWN(buddy, (uintptr_t) 1 << order);
+        if ((uintptr_t) heap->mem.free_tail[index_of(heap, order)] == addr) merged = 1;
+    }
+    CHECK(merged);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_split_halves_go_to_the_cold_end() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    const int index = index_of(heap, ORDER);
+    void *first = pmm_heap_alloc(heap, SIZE);
+    CHECK(first);
+    // use up the blocks of ORDER, so that the next one is split off a bigger block
+    while (heap->mem.free_count[index]) {
+        CHECK(pmm_heap_alloc(heap, SIZE));
+    }
+    void *split = pmm_heap_alloc(heap, SIZE);
+    CHECK(split);
+    const uintptr_t half = block_of(split) ^ ((uintptr_t) 1 << ORDER);
+    CHECK(heap->mem.free_count[index] == 1 && (uintptr_t) heap->mem.free_tail[index] == half);
+
+    // the buddy of first isn't free, so it's not merged but goes to the hot end, ahead of the half
+    pmm_heap_free(heap, first);
+    CHECK((uintptr_t) heap->mem.free_list[index] == block_of(first));
+    CHECK((uintptr_t) heap->mem.free_tail[index] == half);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_address_order_ignores_cold() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    pmm_heap_set_placement(heap, PLACEMENT_ADDRESS);
+    void *blocks[N], *freed[4];
+    scatter(heap, blocks, freed);
+    // the lowest block of ORDER, no matter which end is asked for
+    const uintptr_t lowest = (uintptr_t) heap->mem.free_list[index_of(heap, ORDER)];
+    CHECK(block_of(pmm_heap_alloc_flags(heap, SIZE, PMM_COLD)) == lowest);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+int main() {
+    test_frees_go_to_the_hot_end();
+    test_cold_allocations_take_the_tail();
+    test_merged_blocks_go_to_the_cold_end();
+    test_split_halves_go_to_the_cold_end();
+    test_address_order_ignores_cold();
+    host_exit();
+    return 0;
+}
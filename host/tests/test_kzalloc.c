@@ -0,0 +1,64 @@
+/**
+ * kzalloc returns zeroed memory of any size, and page-sized requests are served by the pool
+ * that `pmm_idle` fills in advance.
+ */
+#include "host.h"
+
+static int is_zero(const uint8_t *p, const size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (p[i]) return 0;
+    }
+    return 1;
+}
+
+static void test_memory_is_zeroed() {
+    host_init(1, 64 << 20);
+    const size_t sizes[] = {1, 8, 100, 128, 129, 4096, PAGE_SIZE, PAGE_SIZE + 1, 100000};
+    for (int i = 0; i < LENGTH(sizes); ++i) {
+        // dirty whatever the next allocation of this size is likely to reuse
+        uint8_t *dirty = pmm->alloc(sizes[i]);
+        CHECK(dirty);
+        memset(dirty, 0xff, sizes[i]);
+        pmm->free(dirty);
+
+        uint8_t *p = kzalloc(sizes[i]);
+        CHECK(p && is_zero(p, sizes[i]));
+        pmm->free(p);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_idle_fills_the_pool() {
+    host_init(1, 64 << 20);
+    const size_t before = host_free_pages();
+    pmm_idle();
+    CHECK(host_free_pages() == before - ZERO_POOL_CAPACITY);
+    pmm_idle(); // full already
+    CHECK(host_free_pages() == before - ZERO_POOL_CAPACITY);
+
+    // pooled pages don't touch free lists
+    void *pages[ZERO_POOL_CAPACITY + 1];
+    for (int i = 0; i < ZERO_POOL_CAPACITY; ++i) {
+        pages[i] = kzalloc(PAGE_SIZE);
+        CHECK(pages[i] && is_zero(pages[i], PAGE_SIZE));
+        memset(pages[i], 0xff, PAGE_SIZE);
+    }
+    CHECK(host_free_pages() == before - ZERO_POOL_CAPACITY);
+    // the pool has run dry, fall back to zeroing in place
+    pages[ZERO_POOL_CAPACITY] = kzalloc(PAGE_SIZE);
+    CHECK(pages[ZERO_POOL_CAPACITY] && is_zero(pages[ZERO_POOL_CAPACITY], PAGE_SIZE));
+    CHECK(host_free_pages() == before - ZERO_POOL_CAPACITY - 1);
+
+    for (int i = 0; i <= ZERO_POOL_CAPACITY; ++i) {
+        pmm->free(pages[i]);
+    }
+    CHECK(host_free_pages() == before);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_memory_is_zeroed();
+    test_idle_fills_the_pool();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * with PMM_LATENCY, every kalloc and kfree lands in exactly one bucket of the histogram of its cpu.
+ */
+#include "host.h"
+
+static void test_operations_are_counted() {
+    host_init(2, 64 << 20);
+    pmm_latency_reset();
+    enum { N = 1000 };
+    static void *cells[N];
+    for (int i = 0; i < N; ++i) {
+        host_set_cpu(i % 2);
+        cells[i] = pmm->alloc(SLAB_CATEGORY[i % SLAB_TYPES]);
+        CHECK(cells[i]);
+    }
+    uint64_t buckets[LATENCY_BUCKETS];
+    CHECK(pmm_latency_histogram(PMM_OP_ALLOC, buckets) == N);
+    uint64_t sum = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        sum += buckets[i];
+    }
+    CHECK(sum == N);
+    CHECK(pmm_latency_histogram(PMM_OP_FREE, buckets) == 0);
+    CHECK(pmm_latency_percentile(PMM_OP_FREE, 500) == 0);
+
+    for (int i = 0; i < N / 2; ++i) {
+        pmm->free(cells[i]);
+    }
+    CHECK(pmm_latency_histogram(PMM_OP_FREE, buckets) == N / 2);
+    host_set_cpu(0);
+}
+
+static void test_percentiles_are_ordered() {
+    host_init(1, 64 << 20);
+    pmm_latency_reset();
+    for (int i = 0; i < 10000; ++i) {
+        pmm->free(pmm->alloc(1 + i % 4096));
+    }
+    const uint64_t p50 = pmm_latency_percentile(PMM_OP_ALLOC, 500);
+    const uint64_t p99 = pmm_latency_percentile(PMM_OP_ALLOC, 990);
+    const uint64_t p999 = pmm_latency_percentile(PMM_OP_ALLOC, 999);
+    CHECK(p50 > 0 && p50 <= p99 && p99 <= p999);
+    // bounds are powers of two
+    CHECK((p50 & (p50 - 1)) == 0 && (p999 & (p999 - 1)) == 0);
+}
+
+static void test_reset_clears_every_cpu() {
+    host_init(4, 64 << 20);
+    for (int cpu = 0; cpu < 4; ++cpu) {
+        host_set_cpu(cpu);
+        pmm->free(pmm->alloc(64));
+    }
+    host_set_cpu(0);
+    pmm_latency_reset();
+    uint64_t buckets[LATENCY_BUCKETS];
+    CHECK(pmm_latency_histogram(PMM_OP_ALLOC, buckets) == 0);
+    CHECK(pmm_latency_histogram(PMM_OP_FREE, buckets) == 0);
+}
+
+int main() {
+    test_operations_are_counted();
+    test_percentiles_are_ordered();
+    test_reset_clears_every_cpu();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * per-cpu state is laid out so that no cache line is written by more than one cpu on the fast
+ * path, see `struct slab_manager`.
+ */
+#include "host.h"
+
+#define LINE_ALIGNED(x) ((uintptr_t) (x) % CACHE_LINE_SIZE == 0)
+
+static void test_structures_are_padded() {
+    CHECK(sizeof(struct slab_manager) % CACHE_LINE_SIZE == 0);
+    // the lock of a manager doesn't share a line with its sentinels
+    CHECK(offsetof(struct slab_manager, sentinels) >= CACHE_LINE_SIZE);
+    CHECK(LINE_ALIGNED(offsetof(struct slab_manager, sentinels)));
+    CHECK(LINE_ALIGNED(offsetof(struct slab_manager, deferred_lock)));
+    CHECK(LINE_ALIGNED(offsetof(struct slab_manager, tag_stats)));
+    // nor does the lock of the buddy allocator with what it protects
+    CHECK(offsetof(struct memory_allocator, base_order) >= CACHE_LINE_SIZE);
+    CHECK(LINE_ALIGNED(offsetof(struct memory_allocator, base_order)));
+}
+
+static void test_managers_are_aligned() {
+    host_init(4, 64 << 20);
+    // the start of the heap is deliberately off a cache line
+    const size_t size = 16 << 20;
+    struct pmm_heap *h = host_heap_create(size + 24);
+    CHECK(h);
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        CHECK(LINE_ALIGNED(&h->managers[cpu]));
+    }
+}
+
+static void alloc_and_free(const int cpu, void *arg) {
+    void *cells[64];
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < LENGTH(cells); ++i) {
+            cells[i] = pmm->alloc(SLAB_CATEGORY[i % SLAB_TYPES]);
+            CHECK(cells[i]);
+        }
+        for (int i = 0; i < LENGTH(cells); ++i) {
+            pmm->free(cells[i]);
+        }
+    }
+}
+
+static void test_every_cpu_finds_its_manager() {
+    host_init(4, 64 << 20);
+    host_run(alloc_and_free, NULL);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        CHECK(sample.used_cells[i] == 0);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_structures_are_padded();
+    test_managers_are_aligned();
+    test_every_cpu_finds_its_manager();
+    host_exit();
+    return 0;
+}
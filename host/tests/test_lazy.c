@@ -0,0 +1,113 @@
+/**
+ * with a lazy threshold, freed blocks of an order stay uncoalesced on their free list, and are
+ * merged only once an allocation of a higher order can't be served otherwise.
+ */
+#include "host.h"
+
+#define ORDER 15
+
+static void test_freed_block_is_not_merged() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    pmm_heap_set_lazy_threshold(heap, ORDER, 4);
+    struct pmm_sample before, allocated, freed;
+    pmm_heap_sample(heap, &before);
+
+    void *p = pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER);
+    CHECK(p);
+    pmm_heap_sample(heap, &allocated);
+    pmm_heap_free(heap, p);
+    pmm_heap_sample(heap, &freed);
+    const int index = ORDER - heap->mem.base_order;
+    CHECK(freed.free_blocks[index] == allocated.free_blocks[index] + 1);
+    CHECK(memcmp(freed.free_blocks + index + 1, allocated.free_blocks + index + 1,
+                 sizeof(freed.free_blocks) - (index + 1) * sizeof(int)) == 0);
+
+    // the next allocation of the same order takes it without splitting
+    CHECK(pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER) == p);
+    pmm_heap_sample(heap, &freed);
+    CHECK(memcmp(&freed, &allocated, sizeof(freed)) == 0);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_eager_by_default() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    struct pmm_sample before, after;
+    pmm_heap_sample(heap, &before);
+    void *p = pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER);
+    CHECK(p);
+    pmm_heap_free(heap, p);
+    pmm_heap_sample(heap, &after);
+    CHECK(memcmp(before.free_blocks, after.free_blocks, sizeof(before.free_blocks)) == 0);
+}
+
+static void test_large_allocation_coalesces() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    struct pmm_sample before, after;
+    pmm_heap_sample(heap, &before);
+    CHECK(before.largest_order > ORDER);
+    // never merged on free
+    pmm_heap_set_lazy_threshold(heap, ORDER, 1 << 20);
+
+    enum { N = (16 << 20) >> ORDER };
+    static void *blocks[N];
+    int n = 0;
+    while (n < N && (blocks[n] = pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER))) n++;
+    CHECK(n > 0);
+    for (int i = 0; i < n; ++i) {
+        pmm_heap_free(heap, blocks[i]);
+    }
+    pmm_heap_sample(heap, &after);
+    CHECK(after.largest_order == ORDER);
+    CHECK(pmm_heap_check(heap) == 0);
+
+    // served by merging them back
+    void *large = pmm_heap_alloc_aligned(heap, (size_t) 1 << before.largest_order, (size_t) 1 << before.largest_order);
+    CHECK(large);
+    pmm_heap_free(heap, large);
+    pmm_heap_sample(heap, &after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_invalid_orders_are_ignored() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    pmm_heap_set_lazy_threshold(heap, heap->mem.base_order - 1, 4);
+    pmm_heap_set_lazy_threshold(heap, heap->mem.max_order + 1, 4);
+    for (int i = 0; i <= heap->mem.max_order - heap->mem.base_order; ++i) {
+        CHECK(heap->mem.lazy_threshold[i] == 0);
+    }
+}
+
+static void test_default_heap() {
+    host_init(1, 16 << 20);
+    pmm_set_lazy_threshold(ORDER, 4);
+    // free_blocks starts at pages, i.e. order 13
+    const int index = ORDER - 13;
+    struct pmm_sample allocated, freed;
+    // until one is split off a bigger block, whose other half stays free
+    void *p;
+    do {
+        p = kalloc_aligned(1 << ORDER, 1 << ORDER);
+        CHECK(p);
+        pmm_sample(&allocated);
+    } while (!allocated.free_blocks[index]);
+    pmm->free(p);
+    pmm_sample(&freed);
+    CHECK(freed.free_blocks[index] == allocated.free_blocks[index] + 1);
+    CHECK(kalloc_aligned(1 << ORDER, 1 << ORDER) == p);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_freed_block_is_not_merged();
+    test_eager_by_default();
+    test_large_allocation_coalesces();
+    test_invalid_orders_are_ignored();
+    test_default_heap();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * initial slabs are populated on the first allocation of each type on each cpu, not at boot.
+ */
+#include "host.h"
+
+static void test_boot_populates_nothing() {
+    host_init(4, 64 << 20);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    for (int i = 0; i < SLAB_TYPES; ++i) {
+        CHECK(sample.slabs[i] == 0);
+    }
+}
+
+static void test_first_allocation_populates_its_type() {
+    host_init(4, 64 << 20);
+    void *p = pmm->alloc(8);
+    CHECK(p);
+    struct pmm_sample sample;
+    pmm_sample(&sample);
+    CHECK(sample.slabs[0] == SLAB_INIT_TURNS[0]);
+    for (int i = 1; i < SLAB_TYPES; ++i) {
+        CHECK(sample.slabs[i] == 0);
+    }
+
+    // other cpus are populated on their own
+    host_set_cpu(2);
+    void *q = pmm->alloc(8);
+    CHECK(q);
+    pmm_sample(&sample);
+    CHECK(sample.slabs[0] == 2 * SLAB_INIT_TURNS[0]);
+    pmm->free(q);
+    host_set_cpu(0);
+    pmm->free(p);
+
+    // initial slabs stay after their cells are freed
+    pmm_sample(&sample);
+    CHECK(sample.slabs[0] == 2 * SLAB_INIT_TURNS[0]);
+    CHECK(sample.used_cells[0] == 0);
+}
+
+int main() {
+    test_boot_populates_nothing();
+    test_first_allocation_populates_its_type();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * PMM_LONG_LIVED cells live in slabs of their own and long-lived blocks are split off the top of
+ * free blocks, so short-lived slabs empty out and go back to the buddy allocator.
+ */
+#include "host.h"
+
+#define TYPE 3 // 64 bytes
+
+static struct pmm_heap *test_heap;
+
+struct occupancy {
+    int slabs, used;
+};
+
+static struct occupancy occupancy(const int lifetime) {
+    struct occupancy o = {0, 0};
+    SlabMetaData *sentinel = &test_heap->managers[0].sentinels[lifetime][TYPE];
+    for (SlabMetaData *p = sentinel->next; p != sentinel; p = p->next) {
+        o.slabs++;
+        o.used += (int) (p->groups * (sizeof(bitmap) * 8)) - p->remaining;
+    }
+    return o;
+}
+
+static void test_cells_are_segregated() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    void *p = pmm_heap_alloc_flags(test_heap, SLAB_CATEGORY[TYPE], PMM_LONG_LIVED);
+    CHECK(p);
+    // no initial slabs for long-lived cells
+    CHECK(occupancy(0).slabs == 0);
+    CHECK(occupancy(1).slabs == 1 && occupancy(1).used == 1);
+    CHECK(test_heap->managers[0].sentinels[1][TYPE].next->status == REUSABLE);
+
+    void *q = pmm_heap_alloc(test_heap, SLAB_CATEGORY[TYPE]);
+    CHECK(q);
+    CHECK(occupancy(0).slabs == SLAB_INIT_TURNS[TYPE] && occupancy(0).used == 1);
+    CHECK(occupancy(1).used == 1);
+
+    // freed to the slab it came from, whatever flags it was allocated with
+    pmm_heap_free(test_heap, p);
+    pmm_heap_free(test_heap, q);
+    CHECK(occupancy(0).used == 0 && occupancy(1).used == 0);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_short_lived_slabs_empty_out() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    enum { N = 8192 };
+    static void *cells[N];
+    for (int i = 0; i < N; ++i) {
+        // one in sixteen outlives the rest
+        cells[i] = pmm_heap_alloc_flags(test_heap, SLAB_CATEGORY[TYPE], i % 16 ? 0 : PMM_LONG_LIVED);
+        CHECK(cells[i]);
+    }
+    CHECK(occupancy(0).slabs > SLAB_INIT_TURNS[TYPE]);
+    for (int i = 0; i < N; ++i) {
+        if (i % 16) pmm_heap_free(test_heap, cells[i]);
+    }
+    // only the initial ones are left, the long-lived cells pin nothing else
+    CHECK(occupancy(0).slabs == SLAB_INIT_TURNS[TYPE] && occupancy(0).used == 0);
+    CHECK(occupancy(1).used == N / 16);
+    for (int i = 0; i < N; i += 16) {
+        pmm_heap_free(test_heap, cells[i]);
+    }
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+/**
+ * @brief a heap of its own whose free space below the largest order is taken, so that the next
+ * block comes out of a block of that order.
+ * @return that block of the largest order.
+ */
+static uintptr_t largest_block(struct pmm_sample *sample) {
+    test_heap = host_heap_create(32 << 20);
+    pmm_heap_sample(test_heap, sample);
+    // a block of 2^(k-1) bytes plus its header takes a block of order k
+    const int base = test_heap->mem.base_order;
+    for (int k = base + 1; k < sample->largest_order; ++k) {
+        for (int i = 0; i < sample->free_blocks[k - base]; ++i) {
+            CHECK(pmm_heap_alloc(test_heap, (size_t) 1 << (k - 1)));
+        }
+    }
+    pmm_heap_sample(test_heap, sample);
+    return (uintptr_t) test_heap->mem.free_list[sample->largest_order - base];
+}
+
+static void test_blocks_are_split_off_opposite_ends() {
+    host_init(1, 16 << 20);
+    struct pmm_sample before, after;
+    // aligned to 128 KiB by `mem_allocate`, which takes a block of 256 KiB
+    enum { SIZE = 100 << 10, ORDER = 18 };
+
+    // the top of the block for a long-lived one
+    uintptr_t block = largest_block(&before);
+    uintptr_t p = (uintptr_t) pmm_heap_alloc_flags(test_heap, SIZE, PMM_LONG_LIVED);
+    CHECK(p >= block + ((uintptr_t) 1 << before.largest_order) - ((uintptr_t) 1 << ORDER));
+    CHECK(p < block + ((uintptr_t) 1 << before.largest_order));
+    pmm_heap_free(test_heap, (void *) p);
+    pmm_heap_sample(test_heap, &after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_heap_check(test_heap) == 0);
+
+    // the bottom for a short-lived one
+    block = largest_block(&before);
+    p = (uintptr_t) pmm_heap_alloc_flags(test_heap, SIZE, 0);
+    CHECK(p >= block && p < block + ((uintptr_t) 1 << ORDER));
+    pmm_heap_free(test_heap, (void *) p);
+    pmm_heap_sample(test_heap, &after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+int main() {
+    test_cells_are_segregated();
+    test_short_lived_slabs_empty_out();
+    test_blocks_are_split_off_opposite_ends();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * pmm_alloc_page_vector takes n pages in a single pass, and pmm_free_page_vector gives them back.
+ */
+#include "host.h"
+
+static void test_pages_are_distinct() {
+    host_init(1, 64 << 20);
+    struct pmm_sample before, after;
+    pmm_sample(&before);
+
+    enum { N = 300 };
+    static void *pages[N];
+    CHECK(pmm_alloc_page_vector(N, pages) == 0);
+    for (int i = 0; i < N; ++i) {
+        CHECK(pages[i] && (uintptr_t) pages[i] % PAGE_SIZE == 0);
+        CHECK(kalloc_usable_size(pages[i]) == PAGE_SIZE);
+        memset(pages[i], i, PAGE_SIZE);
+    }
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < PAGE_SIZE; j += 512) {
+            CHECK(((uint8_t *) pages[i])[j] == (uint8_t) i);
+        }
+    }
+    CHECK(pmm_check() == 0);
+    CHECK(pmm_free_page_vector(pages, N) == 0);
+
+    // buddies among them have coalesced again
+    pmm_sample(&after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_failure_allocates_nothing() {
+    host_init(1, 16 << 20);
+    struct pmm_sample before, after;
+    pmm_sample(&before);
+    static void *pages[4096];
+    CHECK(pmm_alloc_page_vector(LENGTH(pages), pages) == 1);
+    pmm_sample(&after);
+    CHECK(after.largest_order == before.largest_order);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_invalid_pages_are_skipped() {
+    host_init(1, 64 << 20);
+    void *pages[3];
+    CHECK(pmm_alloc_page_vector(2, pages) == 0);
+    pages[2] = (uint8_t *) pages[0] + 8;
+    CHECK(pmm_free_page_vector(pages, 3) == 1);
+    CHECK(pmm_free_page_vector(pages, 2) == 1); // freed already
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_pages_are_distinct();
+    test_failure_allocates_nothing();
+    test_invalid_pages_are_skipped();
+    host_exit();
+    return 0;
+}
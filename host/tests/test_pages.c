@@ -0,0 +1,61 @@
+/**
+ * pmm_alloc_pages and pmm_free_pages hand out naturally aligned blocks without any header.
+ */
+#include "host.h"
+
+static void test_blocks_are_naturally_aligned() {
+    host_init(1, 64 << 20);
+    for (int order = 13; order <= HUGE_PAGE_ORDER; ++order) {
+        uint8_t *p = pmm_alloc_pages(order);
+        CHECK(p);
+        CHECK((uintptr_t) p % ((uintptr_t) 1 << order) == 0);
+        CHECK(kalloc_usable_size(p) == (size_t) 1 << order);
+        // every byte is usable
+        memset(p, 0x5a, (size_t) 1 << order);
+        CHECK(pmm_free_pages(p, order) == 0);
+    }
+    // orders below a page are raised to a page
+    void *p = pmm_alloc_pages(3);
+    CHECK(p && (uintptr_t) p % PAGE_SIZE == 0);
+    CHECK(pmm_free_pages(p, 3) == 0);
+}
+
+static void test_invalid_frees_are_rejected() {
+    host_init(1, 64 << 20);
+    void *p = pmm_alloc_pages(15);
+    CHECK(p);
+    CHECK(pmm_free_pages(p, 14) == 1); // wrong order
+    CHECK(pmm_free_pages((uint8_t *) p + PAGE_SIZE, 15) == 1); // not the beginning
+    CHECK(pmm_free_pages(NULL, 15) == 1);
+    CHECK(pmm_free_pages(p, 15) == 0);
+    CHECK(pmm_free_pages(p, 15) == 1); // twice
+    CHECK(pmm_check() == 0);
+}
+
+static void test_huge_page() {
+    host_init(1, 64 << 20);
+    void *p = pmm_alloc_huge_page();
+    CHECK(p && (uintptr_t) p % ((uintptr_t) 1 << HUGE_PAGE_ORDER) == 0);
+    CHECK(pmm_free_huge_page(p) == 0);
+}
+
+static void test_pages_are_freed_by_kfree() {
+    host_init(1, 64 << 20);
+    struct pmm_sample before, after;
+    pmm_sample(&before);
+    void *p = pmm_alloc_pages(17);
+    CHECK(p);
+    pmm->free(p);
+    pmm_sample(&after);
+    CHECK(before.largest_order == after.largest_order);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_blocks_are_naturally_aligned();
+    test_invalid_frees_are_rejected();
+    test_huge_page();
+    test_pages_are_freed_by_kfree();
+    host_exit();
+    return 0;
+}
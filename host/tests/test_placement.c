@@ -0,0 +1,124 @@
+/**
+ * PLACEMENT_LIFO hands out the most recently freed block of an order, PLACEMENT_ADDRESS the
+ * lowest one, whatever order blocks were freed in.
+ */
+#include "host.h"
+
+// blocks above the fast list orders, so that only free lists are involved
+#define ORDER 15
+#define N 16
+
+static int compare(const void *a, const void *b) {
+    const uintptr_t x = *(const uintptr_t *) a, y = *(const uintptr_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief allocate N blocks and free four of them, none of which is the buddy of another, in an
+ * order that is neither ascending nor descending.
+ * @return the freed blocks in the order they were freed.
+ */
+static void scatter(struct pmm_heap *heap, uintptr_t freed[4]) {
+    uintptr_t blocks[N];
+    for (int i = 0; i < N; ++i) {
+        blocks[i] = (uintptr_t) pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER);
+        CHECK(blocks[i]);
+    }
+    qsort(blocks, N, sizeof(blocks[0]), compare);
+    const int order[4] = {13, 5, 1, 9};
+    for (int i = 0; i < 4; ++i) {
+        freed[i] = blocks[order[i]];
+        pmm_heap_free(heap, (void *) freed[i]);
+    }
+}
+
+static void test_lifo_takes_the_last_freed() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    uintptr_t freed[4];
+    scatter(heap, freed);
+    for (int i = 3; i >= 0; --i) {
+        CHECK((uintptr_t) pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER) == freed[i]);
+    }
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_address_takes_the_lowest() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    pmm_heap_set_placement(heap, PLACEMENT_ADDRESS);
+    uintptr_t freed[4];
+    scatter(heap, freed);
+    qsort(freed, 4, sizeof(freed[0]), compare);
+    for (int i = 0; i < 4; ++i) {
+        CHECK((uintptr_t) pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER) == freed[i]);
+    }
+    CHECK(pmm_heap_check(heap) == 0);
+}
+
+static void test_switching_sorts_free_lists() {
+    host_init(1, 16 << 20);
+    struct pmm_heap *heap = host_heap_create(16 << 20);
+    uintptr_t freed[4];
+    scatter(heap, freed);
+    pmm_heap_set_placement(heap, PLACEMENT_ADDRESS);
+    CHECK(pmm_heap_check(heap) == 0);
+    qsort(freed, 4, sizeof(freed[0]), compare);
+    for (int i = 0; i < 4; ++i) {
+        CHECK((uintptr_t) pmm_heap_alloc_aligned(heap, 1 << ORDER, 1 << ORDER) == freed[i]);
+    }
+}
+
+static void test_address_keeps_high_orders() {
+    // the same churn leaves a block at least as large with address order as with LIFO
+    int largest[2];
+    for (int policy = 0; policy < 2; ++policy) {
+        host_init(1, 16 << 20);
+        struct pmm_heap *heap = host_heap_create(16 << 20);
+        pmm_heap_set_placement(heap, policy ? PLACEMENT_ADDRESS : PLACEMENT_LIFO);
+        enum { LIVE = 256 };
+        static void *live[LIVE];
+        uint64_t seed = 1;
+        for (int step = 0; step < 20000; ++step) {
+            const int j = (int) (host_random(&seed) % LIVE);
+            if (live[j]) pmm_heap_free(heap, live[j]);
+            live[j] = pmm_heap_alloc(heap, 1 + host_random(&seed) % (16 << 10));
+        }
+        // keep one in eight alive
+        for (int j = 0; j < LIVE; ++j) {
+            if (live[j] && j % 8) pmm_heap_free(heap, live[j]);
+            live[j] = NULL;
+        }
+        struct pmm_sample sample;
+        pmm_heap_sample(heap, &sample);
+        largest[policy] = sample.largest_order;
+        CHECK(pmm_heap_check(heap) == 0);
+    }
+    CHECK(largest[1] >= largest[0]);
+}
+
+static void test_default_heap() {
+    host_init(1, 16 << 20);
+    pmm_set_placement(PLACEMENT_ADDRESS);
+    uintptr_t blocks[N];
+    for (int i = 0; i < N; ++i) {
+        blocks[i] = (uintptr_t) kalloc_aligned(1 << ORDER, 1 << ORDER);
+        CHECK(blocks[i]);
+    }
+    qsort(blocks, N, sizeof(blocks[0]), compare);
+    // the lowest of them comes back first, though it's freed first
+    pmm->free((void *) blocks[1]);
+    pmm->free((void *) blocks[9]);
+    CHECK((uintptr_t) kalloc_aligned(1 << ORDER, 1 << ORDER) == blocks[1]);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_lifo_takes_the_last_freed();
+    test_address_takes_the_lowest();
+    test_switching_sorts_free_lists();
+    test_address_keeps_high_orders();
+    test_default_heap();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * pmm_heap_snapshot serializes a heap without changing it, fast lists included, and snapshots
+ * round-trip through host_snapshot_write and host_snapshot_read. The snapshot of the default
+ * heap, taken by pmm_snapshot, is left behind as snapshot.bin for tools/pmm_snapshot.c.
+ */
+#include "host.h"
+
+static struct pmm_heap *test_heap;
+
+static void populate() {
+    host_init(2, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    void *pages[8];
+    for (int i = 0; i < 8; ++i) {
+        pages[i] = pmm_heap_alloc_aligned(test_heap, PAGE_SIZE << (i % FAST_ORDERS), PAGE_SIZE);
+        CHECK(pages[i]);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        pmm_heap_free(test_heap, pages[i]);
+    }
+    for (int i = 0; i < 100; ++i) {
+        CHECK(pmm_heap_alloc(test_heap, 1 + i % 128));
+    }
+    CHECK(pmm_heap_alloc(test_heap, 5000));
+}
+
+static uint8_t *take(struct pmm_heap *heap, size_t *len) {
+    *len = pmm_heap_snapshot(heap, NULL, 0);
+    uint8_t *buf = malloc(*len);
+    CHECK(buf && pmm_heap_snapshot(heap, buf, *len) == *len);
+    return buf;
+}
+
+static void test_fast_lists_are_left_alone() {
+    populate();
+    struct pmm_sample before, after;
+    pmm_heap_sample(test_heap, &before);
+    CHECK(before.fast_blocks[0] > 0);
+    size_t len;
+    uint8_t *buf = take(test_heap, &len);
+    pmm_heap_sample(test_heap, &after);
+    CHECK(memcmp(&before, &after, sizeof(before)) == 0);
+
+    const struct pmm_snapshot_header *header = (struct pmm_snapshot_header *) buf;
+    CHECK(header->magic == PMM_SNAPSHOT_MAGIC && header->version == 2);
+    CHECK(header->fast_orders == FAST_ORDERS && header->reserved == 0);
+    const uint8_t *p = buf + sizeof(*header);
+    for (uint32_t order = header->base_order; order <= header->max_order; ++order) {
+        uint32_t count;
+        memcpy(&count, p, sizeof(count));
+        CHECK(count == (uint32_t) before.free_blocks[order - header->base_order]);
+        p += sizeof(count) + count * sizeof(uint64_t);
+    }
+    for (uint32_t i = 0; i < header->fast_orders; ++i) {
+        uint32_t count;
+        memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        CHECK(count == (uint32_t) before.fast_blocks[i]);
+        for (uint32_t j = 0; j < count; ++j, p += sizeof(uint64_t)) {
+            uint64_t address;
+            memcpy(&address, p, sizeof(address));
+            CHECK(address < header->end - header->start);
+            // naturally aligned, and registered off as every cached block
+            CHECK((header->start + address) % ((uint64_t) 1 << (header->base_order + i)) == 0);
+            CHECK(test_heap->mem.registry[address >> header->base_order] == 0);
+        }
+    }
+    free(buf);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_file_round_trip() {
+    populate();
+    size_t len, read_len;
+    uint8_t *buf = take(test_heap, &len);
+    CHECK(host_snapshot_write(test_heap, "snapshot.bin") == 0);
+    uint8_t *read = host_snapshot_read("snapshot.bin", &read_len);
+    CHECK(read && read_len == len && memcmp(buf, read, len) == 0);
+    free(read);
+    free(buf);
+}
+
+static void test_default_heap() {
+    host_init(2, 16 << 20);
+    for (int i = 0; i < 100; ++i) {
+        CHECK(pmm->alloc(1 + i % 128));
+    }
+    CHECK(pmm->alloc(5000) && pmm_alloc_pages(15));
+    const size_t len = pmm_snapshot(NULL, 0);
+    uint8_t *buf = malloc(len);
+    CHECK(buf && pmm_snapshot(buf, len) == len);
+    const struct pmm_snapshot_header *header = (struct pmm_snapshot_header *) buf;
+    // it's the heap behind kalloc, which lies in `heap` after its metadata
+    CHECK(header->magic == PMM_SNAPSHOT_MAGIC);
+    CHECK(header->start > (uintptr_t) heap.start && header->end <= (uintptr_t) heap.end);
+
+    // this is the one left behind for the tool
+    size_t read_len;
+    CHECK(host_snapshot_write(NULL, "snapshot.bin") == 0);
+    uint8_t *read = host_snapshot_read("snapshot.bin", &read_len);
+    CHECK(read && read_len == len && memcmp(buf, read, len) == 0);
+    free(read);
+    free(buf);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_short_buffer() {
+    populate();
+    size_t len;
+    uint8_t *buf = take(test_heap, &len);
+    uint8_t small[64];
+    memset(small, 0x5a, sizeof(small));
+    CHECK(pmm_heap_snapshot(test_heap, small, 32) == len);
+    for (int i = 32; i < 64; ++i) {
+        CHECK(small[i] == 0x5a);
+    }
+    free(buf);
+}
+
+static void test_reader_rejects_other_files() {
+    size_t len;
+    CHECK(host_snapshot_read("no such snapshot", &len) == NULL);
+    FILE *file = fopen("not_a_snapshot.bin", "wb");
+    CHECK(file);
+    fprintf(file, "%064d", 0);
+    fclose(file);
+    CHECK(host_snapshot_read("not_a_snapshot.bin", &len) == NULL);
+    remove("not_a_snapshot.bin");
+}
+
+int main() {
+    test_fast_lists_are_left_alone();
+    test_short_buffer();
+    test_reader_rejects_other_files();
+    test_file_round_trip();
+    test_default_heap();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * tagged allocations are accounted to their tag over all cpus, frees which are rejected are not
+ * taken off, and quotas refuse allocations without PMM_CRITICAL. Other cpus see what a cpu has
+ * allocated once it has made PMM_TAG_REFRESH tagged allocations and frees.
+ */
+#include "host.h"
+
+#define TAG 3
+
+static struct pmm_heap *test_heap;
+
+static struct pmm_tag_stats stats(const int tag) {
+    struct pmm_tag_stats s;
+    pmm_heap_tag_stats(test_heap, tag, &s);
+    return s;
+}
+
+static void test_live_bytes_follow_usable_size() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    void *a = pmm_heap_alloc_flags(test_heap, 40, PMM_TAG(TAG));
+    void *b = pmm_heap_alloc_flags(test_heap, 5000, PMM_TAG(TAG));
+    void *c = pmm_heap_alloc_flags(test_heap, 40, 0);
+    CHECK(a && b && c);
+    const int64_t live = (int64_t) (pmm_heap_usable_size(test_heap, a) + pmm_heap_usable_size(test_heap, b));
+    CHECK(stats(TAG).live_bytes == live && stats(TAG).allocs == 2 && stats(TAG).frees == 0);
+
+    pmm_heap_free_tagged(test_heap, a, TAG);
+    pmm_heap_free_tagged(test_heap, b, TAG);
+    pmm_heap_free(test_heap, c);
+    CHECK(stats(TAG).live_bytes == 0 && stats(TAG).frees == 2);
+    // untagged and invalid tags are never accounted
+    CHECK(stats(0).allocs == 0 && stats(PMM_TAGS).allocs == 0);
+}
+
+static void test_rejected_frees_are_not_taken_off() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    void *keep = pmm_heap_alloc_flags(test_heap, 64, PMM_TAG(TAG));
+    void *cell = pmm_heap_alloc_flags(test_heap, 64, PMM_TAG(TAG));
+    void *block = pmm_heap_alloc_flags(test_heap, 5000, PMM_TAG(TAG));
+    CHECK(keep && cell && block);
+    const int64_t live = (int64_t) pmm_heap_usable_size(test_heap, keep);
+
+    pmm_heap_free_tagged(test_heap, cell, TAG);
+    pmm_heap_free_tagged(test_heap, cell, TAG);
+    pmm_heap_free_tagged(test_heap, block, TAG);
+    pmm_heap_free_tagged(test_heap, block, TAG);
+    int local;
+    pmm_heap_free_tagged(test_heap, &local, TAG);
+    CHECK(stats(TAG).live_bytes == live && stats(TAG).frees == 2);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void allocate_all(const int cpu, void *arg) {
+    void **cells = arg;
+    for (int i = 0; i < 100; ++i) {
+        if (cpu == 0) {
+            cells[i] = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG));
+            CHECK(cells[i]);
+        }
+    }
+}
+
+static void free_all(const int cpu, void *arg) {
+    void **cells = arg;
+    for (int i = 0; i < 100; ++i) {
+        if (cpu == 1) pmm_heap_free_tagged(test_heap, cells[i], TAG);
+    }
+}
+
+static void test_cross_cpu_frees() {
+    host_init(2, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    static void *cells[100];
+    host_run(allocate_all, cells);
+    CHECK(stats(TAG).live_bytes == 100 * 128);
+    host_run(free_all, cells);
+    CHECK(stats(TAG).live_bytes == 0 && stats(TAG).allocs == 100 && stats(TAG).frees == 100);
+}
+
+static void test_quota() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    pmm_heap_set_tag_quota(test_heap, TAG, 4 * 128);
+    void *cells[4];
+    for (int i = 0; i < 4; ++i) {
+        cells[i] = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG));
+        CHECK(cells[i]);
+    }
+    CHECK(pmm_heap_alloc_flags(test_heap, 1, PMM_TAG(TAG)) == NULL);
+    CHECK(stats(TAG).refused == 1);
+    // other tags and critical allocations are not limited
+    void *other = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG + 1));
+    void *critical = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG) | PMM_CRITICAL);
+    CHECK(other && critical);
+    CHECK(stats(TAG).live_bytes == 5 * 128);
+
+    // room again once freed
+    pmm_heap_free_tagged(test_heap, critical, TAG);
+    pmm_heap_free_tagged(test_heap, cells[0], TAG);
+    void *again = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG));
+    CHECK(again);
+    pmm_heap_free_tagged(test_heap, again, TAG);
+    for (int i = 1; i < 4; ++i) {
+        pmm_heap_free_tagged(test_heap, cells[i], TAG);
+    }
+    pmm_heap_free_tagged(test_heap, other, TAG + 1);
+    CHECK(stats(TAG).live_bytes == 0 && stats(TAG + 1).live_bytes == 0);
+}
+
+static void allocate_refresh(const int cpu, void *arg) {
+    void **cells = arg;
+    for (int i = 0; i < PMM_TAG_REFRESH; ++i) {
+        if (cpu == 0) {
+            cells[i] = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG));
+            CHECK(cells[i]);
+        }
+    }
+}
+
+static void allocate_over_quota(const int cpu, void *arg) {
+    if (cpu == 1) CHECK(pmm_heap_alloc_flags(test_heap, 1, PMM_TAG(TAG)) == NULL);
+}
+
+static void free_refresh(const int cpu, void *arg) {
+    void **cells = arg;
+    for (int i = 0; i < PMM_TAG_REFRESH; ++i) {
+        if (cpu == 1) pmm_heap_free_tagged(test_heap, cells[i], TAG);
+    }
+}
+
+static void test_quota_across_cpus() {
+    host_init(2, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    pmm_heap_set_tag_quota(test_heap, TAG, PMM_TAG_REFRESH * 128);
+    static void *cells[PMM_TAG_REFRESH];
+    host_run(allocate_refresh, cells);
+    host_run(allocate_over_quota, NULL);
+    CHECK(stats(TAG).refused == 1);
+    // and once another cpu has freed them, the sum is taken again before refusing
+    host_run(free_refresh, cells);
+    CHECK(stats(TAG).live_bytes == 0);
+    host_set_cpu(1);
+    void *cell = pmm_heap_alloc_flags(test_heap, 128, PMM_TAG(TAG));
+    CHECK(cell);
+    pmm_heap_free_tagged(test_heap, cell, TAG);
+    host_set_cpu(0);
+}
+
+static void test_default_heap() {
+    host_init(1, 16 << 20);
+    pmm_set_tag_quota(TAG, 128);
+    void *cell = kalloc_flags(128, PMM_TAG(TAG));
+    CHECK(cell && kalloc_flags(1, PMM_TAG(TAG)) == NULL);
+    struct pmm_tag_stats s;
+    pmm_tag_stats(TAG, &s);
+    CHECK(s.live_bytes == 128 && s.allocs == 1 && s.refused == 1);
+    kfree_tagged(cell, TAG);
+    pmm_tag_stats(TAG, &s);
+    CHECK(s.live_bytes == 0 && s.frees == 1);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_live_bytes_follow_usable_size();
+    test_rejected_frees_are_not_taken_off();
+    test_cross_cpu_frees();
+    test_quota();
+    test_quota_across_cpus();
+    test_default_heap();
+    host_exit();
+    return 0;
+}
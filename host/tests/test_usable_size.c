@@ -0,0 +1,78 @@
+/**
+ * kalloc_usable_size answers from registry and metadata alone, for every kind of block, and the
+ * whole usable size can be written without breaking the heap.
+ */
+#include "host.h"
+
+static void test_slab_cells_are_typeSize() {
+    host_init(1, 64 << 20);
+    for (size_t size = 1; size <= (size_t) SLAB_CATEGORY[SLAB_TYPES - 1]; ++size) {
+        void *p = pmm->alloc(size);
+        CHECK(p);
+        const size_t usable = kalloc_usable_size(p);
+        // the smallest type that fits
+        int type = 0;
+        while ((size_t) SLAB_CATEGORY[type] < size) type++;
+        CHECK(usable == (size_t) SLAB_CATEGORY[type]);
+        memset(p, 0xa5, usable);
+        pmm->free(p);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_mem_blocks_cover_the_request() {
+    host_init(1, 64 << 20);
+    for (size_t size = (size_t) SLAB_CATEGORY[SLAB_TYPES - 1] + 1; size <= MAX_REQUEST_MEM; size = size * 3 / 2) {
+        void *p = pmm->alloc(size);
+        CHECK(p);
+        const size_t usable = kalloc_usable_size(p);
+        CHECK(usable >= size);
+        memset(p, 0xa5, usable);
+        CHECK(pmm_check() == 0);
+        pmm->free(p);
+    }
+    CHECK(pmm_check() == 0);
+}
+
+static void test_page_blocks_are_whole() {
+    host_init(1, 64 << 20);
+    void *p = kalloc_aligned(3 * PAGE_SIZE, PAGE_SIZE);
+    CHECK(p && kalloc_usable_size(p) == 4 * PAGE_SIZE);
+    pmm->free(p);
+    void *q = kalloc_aligned(40, 64);
+    CHECK(q && kalloc_usable_size(q) == 64);
+    pmm->free(q);
+}
+
+static void test_user_data_is_not_metadata() {
+    host_init(1, 64 << 20);
+    // a block full of the slab magic word right ahead of slab cells
+    uint32_t *block = pmm->alloc(PAGE_SIZE);
+    CHECK(block);
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); ++i) {
+        block[i] = SLAB_METADATA_MAGIC;
+    }
+    void *cell = pmm->alloc(32);
+    CHECK(cell && kalloc_usable_size(cell) == 32);
+    CHECK(kalloc_usable_size(block) >= PAGE_SIZE);
+    pmm->free(cell);
+    pmm->free(block);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_out_of_heap_is_zero() {
+    host_init(1, 64 << 20);
+    int local;
+    CHECK(kalloc_usable_size(&local) == 0);
+    CHECK(kalloc_usable_size(NULL) == 0);
+}
+
+int main() {
+    test_slab_cells_are_typeSize();
+    test_mem_blocks_cover_the_request();
+    test_page_blocks_are_whole();
+    test_user_data_is_not_metadata();
+    test_out_of_heap_is_zero();
+    host_exit();
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * the min watermark is a reserve only PMM_CRITICAL allocations may take, fast lists and page
+ * vectors included, and reclaimers are run on failure and below the low watermark, without a
+ * lock held.
+ */
+#include "host.h"
+
+static struct pmm_heap *test_heap;
+
+static void test_min_reserve_covers_fast_lists() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    void *p = pmm_heap_alloc_aligned(test_heap, PAGE_SIZE, PAGE_SIZE);
+    CHECK(p);
+    pmm_heap_free(test_heap, p);
+    struct pmm_sample sample;
+    pmm_heap_sample(test_heap, &sample);
+    CHECK(sample.fast_blocks[0] > 0);
+
+    // more than fast lists can ever hold
+    pmm_heap_set_watermarks(test_heap, test_heap->mem.free_pages + 4 * FAST_LIST_LIMIT, 0);
+    CHECK(pmm_heap_alloc_aligned(test_heap, PAGE_SIZE, PAGE_SIZE) == NULL);
+    CHECK(pmm_heap_alloc_flags(test_heap, 1 << 20, 0) == NULL);
+    CHECK(pmm_heap_alloc_flags(test_heap, 8, 0) == NULL);
+    void *critical = pmm_heap_alloc_flags(test_heap, 8, PMM_CRITICAL);
+    CHECK(critical);
+    pmm_heap_free(test_heap, critical);
+
+    pmm_heap_set_watermarks(test_heap, 0, 0);
+    p = pmm_heap_alloc_aligned(test_heap, PAGE_SIZE, PAGE_SIZE);
+    CHECK(p);
+    pmm_heap_free(test_heap, p);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+struct held {
+    void *blocks[64];
+    int count;
+    int calls;
+};
+
+// gives back one block per call
+static size_t release_one(struct pmm_heap *h, void *arg) {
+    struct held *held = arg;
+    __atomic_fetch_add(&held->calls, 1, __ATOMIC_SEQ_CST);
+    if (!held->count) return 0;
+    pmm_heap_free(h, held->blocks[--held->count]);
+    return (1 << 20) / PAGE_SIZE;
+}
+
+static void test_reclaim_on_failure() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    static struct held held;
+    memset(&held, 0, sizeof(held));
+    while (held.count < (int) LENGTH(held.blocks) && (held.blocks[held.count] = pmm_heap_alloc(test_heap, 1 << 20))) {
+        held.count++;
+    }
+    CHECK(held.count > 0 && held.count < (int) LENGTH(held.blocks));
+    CHECK(pmm_heap_register_reclaim(test_heap, release_one, &held) == 0);
+
+    const int count = held.count;
+    void *p = pmm_heap_alloc(test_heap, 1 << 20);
+    CHECK(p);
+    CHECK(held.calls == 1 && held.count == count - 1);
+    pmm_heap_free(test_heap, p);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static void test_reclaim_below_low() {
+    host_init(1, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    static struct held held;
+    memset(&held, 0, sizeof(held));
+    CHECK(pmm_heap_register_reclaim(test_heap, release_one, &held) == 0);
+
+    void *p = pmm_heap_alloc(test_heap, 64);
+    CHECK(p && held.calls == 0);
+    pmm_heap_set_watermarks(test_heap, 0, test_heap->mem.free_pages + 1);
+    void *q = pmm_heap_alloc(test_heap, 64);
+    CHECK(q && held.calls == 1);
+    pmm_heap_free(test_heap, p);
+    pmm_heap_free(test_heap, q);
+}
+
+static struct {
+    int inside;
+    int met;
+    int calls;
+    int blocking;
+    int released;
+} rendezvous;
+
+static void wait_for(const int *flag, const int value) {
+    const uint64_t deadline = host_clock_ns() + 5000000000ull;
+    while (__atomic_load_n(flag, __ATOMIC_SEQ_CST) < value) {
+        CHECK(host_clock_ns() < deadline);
+        yield();
+    }
+}
+
+// returns only once every cpu is inside
+static size_t meet(struct pmm_heap *h, void *arg) {
+    __atomic_fetch_add(&rendezvous.inside, 1, __ATOMIC_SEQ_CST);
+    wait_for(&rendezvous.inside, cpu_count());
+    __atomic_fetch_add(&rendezvous.met, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static void reclaim(const int cpu, void *arg) {
+    pmm_heap_reclaim(test_heap);
+}
+
+static void test_reclaimers_run_unlocked() {
+    host_init(2, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    memset(&rendezvous, 0, sizeof(rendezvous));
+    CHECK(pmm_heap_register_reclaim(test_heap, meet, NULL) == 0);
+    host_run(reclaim, NULL);
+    CHECK(rendezvous.met == 2);
+}
+
+// the first call holds on until the other cpu has allocated
+static size_t hold(struct pmm_heap *h, void *arg) {
+    if (__atomic_fetch_add(&rendezvous.calls, 1, __ATOMIC_SEQ_CST) == 0) {
+        __atomic_store_n(&rendezvous.blocking, 1, __ATOMIC_SEQ_CST);
+        wait_for(&rendezvous.released, 1);
+    }
+    return 0;
+}
+
+static void allocate_below_low(const int cpu, void *arg) {
+    void *cells[16];
+    if (cpu == 0) {
+        cells[0] = pmm_heap_alloc(test_heap, 64);
+        CHECK(cells[0]);
+        pmm_heap_free(test_heap, cells[0]);
+        return;
+    }
+    wait_for(&rendezvous.blocking, 1);
+    for (size_t i = 0; i < LENGTH(cells); ++i) {
+        cells[i] = pmm_heap_alloc(test_heap, 64);
+        CHECK(cells[i]);
+    }
+    __atomic_store_n(&rendezvous.released, 1, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < LENGTH(cells); ++i) {
+        pmm_heap_free(test_heap, cells[i]);
+    }
+}
+
+static void test_low_watermark_backs_off() {
+    host_init(2, 16 << 20);
+    test_heap = host_heap_create(32 << 20);
+    memset(&rendezvous, 0, sizeof(rendezvous));
+    CHECK(pmm_heap_register_reclaim(test_heap, hold, NULL) == 0);
+    // every allocation is below it
+    pmm_heap_set_watermarks(test_heap, 0, (size_t) 1 << 30);
+    host_run(allocate_below_low, NULL);
+    CHECK(rendezvous.calls == 1);
+    CHECK(pmm_heap_check(test_heap) == 0);
+}
+
+static size_t count_calls(struct pmm_heap *h, void *arg) {
+    ++*(int *) arg;
+    return 0;
+}
+
+static void test_default_heap() {
+    host_init(1, 16 << 20);
+    pmm_set_watermarks(host_free_pages() + 1, 0);
+    CHECK(kalloc_flags(8, 0) == NULL);
+    void *critical = kalloc_flags(8, PMM_CRITICAL);
+    CHECK(critical);
+    pmm->free(critical);
+
+    static int calls;
+    calls = 0;
+    CHECK(pmm_register_reclaim(count_calls, &calls) == 0);
+    pmm_set_watermarks(0, (size_t) 1 << 30);
+    void *p = kalloc_flags(8, 0);
+    CHECK(p && calls == 1);
+    pmm->free(p);
+    CHECK(pmm_check() == 0);
+}
+
+static void test_page_vector_keeps_the_reserve() {
+    host_init(1, 16 << 20);
+    void *pages[4];
+    pmm_set_watermarks(host_free_pages() - 2, 0);
+    CHECK(pmm_alloc_page_vector(4, pages) == 1);
+    CHECK(pmm_alloc_page_vector(2, pages) == 0);
+    CHECK(pmm_alloc_page_vector(1, pages + 2) == 1);
+    CHECK(pmm_free_page_vector(pages, 2) == 0);
+    CHECK(pmm_check() == 0);
+}
+
+int main() {
+    test_min_reserve_covers_fast_lists();
+    test_reclaim_on_failure();
+    test_reclaim_below_low();
+    test_reclaimers_run_unlocked();
+    test_low_watermark_backs_off();
+    test_default_heap();
+    test_page_vector_keeps_the_reserve();
+    host_exit();
+    return 0;
+}
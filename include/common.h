@@ -24,11 +24,26 @@ extern const int SLAB_CATEGORY[SLAB_TYPES];
 extern const int SLAB_INIT_PAGES_PER_TURN[SLAB_TYPES];
 // todo explain why
 extern const int SLAB_INIT_TURNS[SLAB_TYPES];
+/* whether free cells of each type form an embedded freelist (each free cell holds the address
+ * of the next one) rather than being looked up in bitmaps. Bitmaps are then only maintained
+ * for validation, unless NDEBUG is defined. */
+extern const int SLAB_FREELIST[SLAB_TYPES];
+// the upper bound of pages a slab grows by at a time, see `private__slab_grow`.
+#define SLAB_MAX_GROW_PAGES 8
 //int SLAB_TOTAL_PAGES[] = {5, 8, 15, 12, 12};
 // SLAB_TOTAL_PAGES[i] = SLAB_INIT_PAGES_PER_TURN[i] * SLAB_INIT_TURNS[i];
 
 typedef int SpinLock;
 
+// state written by different cpus is kept in different cache lines to avoid false sharing.
+#define CACHE_LINE_SIZE 64
+#ifndef PMM_PACKED
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+#else
+// the layout without padding, only for measuring what it's worth, see host/bench/false_sharing.c
+#define CACHE_ALIGNED
+#endif
+
 inline void lock_init(SpinLock *lock) {
     atomic_xchg(lock, 0);
 }
@@ -62,27 +77,129 @@ inline void lock_release(SpinLock *lock) {
 /***** memory metadata ************/
 typedef struct mem_metadata {
     int MAGIC;
-    struct mem_metadata *next;
+    struct mem_metadata *next, *prev;
 } MemMetaData;
 
 /***** memory allocator ************/
+/**
+ * a free list whose head is tagged, which supports lock-free push and pop.
+ * head = (tag << 32) | (index of page + 1), where index is relative to `start` of allocator
+ * and 0 stands for an empty list. Tag increases on every change of head, which prevents ABA.
+ */
+struct tagged_list {
+    uint64_t head;
+    int count; // approximate, only used to bound the length
+} CACHE_ALIGNED;
+
+// the smallest FAST_ORDERS orders are cached in lock-free lists, see `private__fast_alloc`.
+#define FAST_ORDERS 2
+#define FAST_LIST_LIMIT 64
+#define FAST_LIST_BATCH 16
+
+/**
+ * where free blocks of each order are taken from.
+ * PLACEMENT_LIFO: the most recently freed block first, O(1) for both free and allocation.
+ * PLACEMENT_ADDRESS: the lowest address first. Each free list is kept sorted, which costs a walk
+ * on every insertion, but allocations are packed towards the start of the heap, so blocks at
+ * higher addresses stay intact and keep coalescing into high orders.
+ */
+enum placement {
+    PLACEMENT_LIFO, PLACEMENT_ADDRESS
+};
+
+#ifndef PMM_PLACEMENT
+#define PMM_PLACEMENT PLACEMENT_LIFO
+#endif
+
 /**
  * @note all sizes relating to memory_allocator are gross sizes rather than net
  * sizes, which means that the size of metadata should be accounted for.
  */
 struct memory_allocator {
-    SpinLock lock;
-    int base_order; // the order of 'page size'
+    // every waiting cpu keeps writing the lock, so it gets a cache line of its own
+    SpinLock lock CACHE_ALIGNED;
+    int base_order CACHE_ALIGNED; // the order of 'page size'
     int max_order;
+    uintptr_t start, end; // the range of pages managed by this allocator
+    enum placement placement;
     /*  index <- order of size - base_order. (all sizes are power of two).
         free_list[index] -> address */
     MemMetaData *free_list[1 + 32 - 13]; // an array of pointer to MemMetaData.
+    /* the other end of each free list. With PLACEMENT_LIFO, the head is the hot end where blocks
+       freed as they are go, and the tail is the cold end where blocks that have just been merged or
+       split off go. Cold blocks are handed to PMM_COLD allocations, which then leave hot blocks for
+       allocations that will touch them right away. */
+    MemMetaData *free_tail[1 + 32 - 13];
+    int free_count[1 + 32 - 13]; // the length of each free list
+    size_t free_pages; // pages in all free lists
+    /* watermarks, in pages. Once free_pages drops below low, reclaimers are run; the last min
+       pages are reserved for allocations with PMM_CRITICAL. */
+    size_t watermark_low, watermark_min;
+    /* lazy buddy: freed blocks are not coalesced as long as their free list is shorter than
+       the threshold, until an allocation can't be served. 0 means coalescing eagerly. */
+    int lazy_threshold[1 + 32 - 13];
 
-    // index <- (page's address >> base_order)
+    // index <- ((page's address - start) >> base_order)
     // mp[index] -> actual order and actual order is valid if `actual order` >= `base_order`
-    uint8_t registry[1 << 19]; // registry
+    uint8_t *registry; // registry, one entry per page, placed ahead of start
+
+    /* blocks cached in fast_list are neither in free_list nor registered, in other words, they
+       are allocated as far as free_list is concerned. fast_list[index] <- order - base_order */
+    struct tagged_list fast_list[FAST_ORDERS];
 };
 
+// set in registry along with the order, if the block is handed out by `pmm_alloc_pages`.
+#define REGISTRY_PAGE 0x80
+/* set in registry of every page of a slab, along with the order of its alignment, so that
+   slab metadata = ROUNDDOWN(addr, 1 << order). Slab pages never begin a block. */
+#define REGISTRY_SLAB 0x40
+
+/***** page allocation *************/
+#define HUGE_PAGE_ORDER 21 // 2 MiB
+
+void *pmm_alloc_pages(int order);
+
+int pmm_free_pages(void *ptr, int order);
+
+void *pmm_alloc_huge_page();
+
+int pmm_free_huge_page(void *ptr);
+
+int pmm_alloc_page_vector(size_t n, void **pages);
+
+int pmm_free_page_vector(void **pages, size_t n);
+
+/***** arena ***********************/
+/**
+ * short-lived objects are bumped out of chunks which come from `pmm_alloc_pages`,
+ * and they are given back all together by resetting or destroying the arena.
+ *     chunk                           top              end
+ *     *************************************************
+ *     * header *  allocated objects   |   free space   *
+ *     *************************************************
+ */
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    uintptr_t top; // the beginning of free space
+    uintptr_t end;
+    int order; // the chunk is 2^order bytes
+};
+
+struct pmm_arena {
+    struct arena_chunk *chunks; // singly linked list, the newest first
+    int chunk_order;
+};
+
+void pmm_arena_init(struct pmm_arena *arena, size_t chunk_size);
+
+void *pmm_arena_alloc(struct pmm_arena *arena, size_t size);
+
+void pmm_arena_reset(struct pmm_arena *arena);
+
+void pmm_arena_destroy(struct pmm_arena *arena);
+
 /***** SLAB ALLOCATION *************/
 
 // one bitmap keeps track of a single group, a group contains (sizeof(bitmap) * 8) members.
@@ -97,26 +214,398 @@ typedef enum status {
     SENTINEL, INITIAL, REUSABLE
 } Status;
 
+/**
+ * fields written on every allocation and deallocation come first, so that they share
+ * as few cache lines as possible with fields which never change after initialization.
+ */
 typedef struct slab_metadata {
+    /* hot */
     // circular doubly linked list, acting as a deque
     struct slab_metadata *next, *prev;
+    int remaining; // how many cells are left, unnecessary for sentinel
+    bitmap *p_bitmap; // point to the start of bitmap, unnecessary for sentinel
+    void *free_cell; // the head of embedded freelist, only used if `freelist` is set
+    int allocs; // for sentinel, how many cells have been allocated since the last growth
+
+    /* cold */
     int MAGIC;
     Status status;
     int typeSize; // such as 8,16...
+    int freelist; // copied from SLAB_FREELIST
+    int lifetime; // 0 for short-lived cells and 1 for long-lived ones, copied from sentinel
+    // the sentinel of the list this slab is in, so that its manager is found in O(1)
+    struct slab_metadata *sentinel;
 
     // below are unnecessary for sentinel
-    int remaining; // how many cells are left
     int groups;
-    bitmap *p_bitmap; // point to the start of bitmap;
     /* the distance between the beginning of slab_metadata and actual storage.
      * offset = actual storage address - slab_metadata; */
     size_t offset;
+    // for sentinel, the color of the next slab; otherwise, the color of this slab.
+    int color;
+    // for sentinel, how many pages the next slab takes, 1 <= grow_pages <= SLAB_MAX_GROW_PAGES.
+    int grow_pages;
+#ifdef PMM_HARDENED
+    // one byte per cell, its requested size plus one; 0, if it's free. See hardened mode.
+    uint8_t *requested;
+#endif
 } SlabMetaData;
 
+/***** allocation tags ***********/
+/* the subsystem the allocation is attributed to, 0 stands for none. Live bytes and counts of
+   tagged allocations are kept per tag, see `pmm_heap_tag_stats`. */
+#define PMM_TAGS 16
+#define PMM_TAG_SHIFT 8
+#define PMM_TAG(tag) ((tag) << PMM_TAG_SHIFT)
+// how many tagged allocations and frees of a tag each cpu makes before it sums up live bytes of the
+// tag again for quota checks, see `pmm_heap_alloc_flags`
+#ifndef PMM_TAG_REFRESH
+#define PMM_TAG_REFRESH 64
+#endif
+
+struct pmm_tag_stats {
+    int64_t live_bytes; // negative on a cpu which frees more than it allocates, only sums make sense
+    uint64_t allocs, frees;
+    uint64_t refused; // allocations refused by the quota
+};
+
+/***** hardened mode *************/
+/**
+ * with PMM_HARDENED defined, slab cells and blocks from `mem_allocate` carry their requested size
+ * out of reach of ordinary overflows, and whatever follows it up to the usable size is a trailing
+ * redzone filled with PMM_REDZONE_BYTE. Every request is padded by PMM_REDZONE_MIN bytes before
+ * its cell or block is chosen, so that the redzone is never empty, even for a request of exactly
+ * the size of a type or of a page.
+ * - a slab keeps one byte per cell in SlabMetaData.requested, the requested size plus one, so
+ *   that 0 stands for a free cell. An underflow of a cell runs into the redzone of the cell
+ *   ahead, and PMM_REDZONE_GUARD bytes ahead of the first cell guard the metadata and bitmaps:
+ *     * SlabMetaData * bitmaps * requested * ... * guard * cell | redzone * cell ...       *
+ * - a block keeps a redzone_header ahead of its offset, and PMM_REDZONE_GUARD bytes ahead of
+ *   that guard MemMetaData. An underflow breaks the offset, so the block isn't found anymore:
+ *     * MemMetaData * ... * guard * header * offset * requested space | redzone ...        *
+ * The requested size, guards and redzones are verified on free, and by `pmm_heap_check`. The
+ * requested size is then cleared, so that a double free is told apart, the whole usable space
+ * is poisoned by PMM_POISON_BYTE and held in a quarantine of current cpu, which delays reuse
+ * until PMM_QUARANTINE later frees. Overflows, underflows, invalid and double frees are counted
+ * as violations and the space is never reused.
+ * `kalloc_aligned` and `kzalloc` go through the same path, rather than handing out page blocks.
+ * Page blocks of `pmm_alloc_pages` and page vectors, whose callers own every byte, and arena
+ * chunks have no room for any of these and are left out; arena chunks are only poisoned once
+ * the arena is reset or destroyed.
+ */
+#ifdef PMM_HARDENED
+#define PMM_REDZONE_BYTE 0xbb
+#define PMM_POISON_BYTE 0x6b
+#define PMM_REDZONE_CHECK 0x5a5aa5a5
+#define PMM_REDZONE_GUARD 16
+#define PMM_REDZONE_MIN 16
+#ifndef PMM_QUARANTINE
+#define PMM_QUARANTINE 256
+#endif
+
+struct redzone_header {
+    uint32_t size, check; // the requested size, 0 once freed, and size ^ PMM_REDZONE_CHECK
+};
+
+struct pmm_hardened_stats {
+    uint64_t redzone_bytes; // bytes between requested and usable sizes, i.e. trailing redzones
+    uint64_t poisoned_bytes;
+    uint64_t quarantined; // frees that have been through the quarantine
+    int64_t quarantine_bytes; // bytes held in quarantine now
+    uint64_t violations; // invalid frees, double frees and overflows
+};
+#endif
+
+/***** latency histogram *********/
+/**
+ * with PMM_LATENCY defined, every kalloc and kfree is timed by PMM_CLOCK() and counted in a
+ * histogram of current cpu, where bucket i counts operations that took [2^i, 2^(i+1)) ticks.
+ * Tail latencies are then read by `pmm_latency_percentile`, whole histograms by
+ * `pmm_latency_histogram`.
+ */
+#ifdef PMM_LATENCY
+#define LATENCY_BUCKETS 40
+
+#ifndef PMM_CLOCK
+#if defined(__x86_64__) || defined(__i386__)
+#define PMM_CLOCK() __builtin_ia32_rdtsc()
+#else
+#error "PMM_LATENCY requires PMM_CLOCK() which returns a monotonic count of ticks"
+#endif
+#endif
+
+enum pmm_op {
+    PMM_OP_ALLOC, PMM_OP_FREE, PMM_OPS
+};
+#endif
+
 /***** slab manager ****************/
-// every cpu has a single slab_manager
+// short-lived and long-lived cells never share a slab, see PMM_LONG_LIVED
+#define LIFETIMES 2
+
+// how many pre-zeroed pages each cpu keeps at most, see `pmm_refill_zero_pool`
+#ifndef ZERO_POOL_CAPACITY
+#define ZERO_POOL_CAPACITY 8
+#endif
+
+// how many pointers each cpu queues before it drains the expired ones, see `kfree_deferred`
+#ifndef DEFERRED_THRESHOLD
+#define DEFERRED_THRESHOLD 64
+#endif
+// how many pointers each cpu queues at most, beyond which `kfree_deferred` waits
+#define DEFERRED_CAPACITY (4 * DEFERRED_THRESHOLD)
+
+struct deferred_entry {
+    void *ptr;
+    uint64_t epoch; // the epoch of heap when ptr was queued, see `pmm_quiescent`
+};
+
+/**
+ * every cpu has a single slab_manager.
+ * Managers are aligned to cache lines, so that neighboring cpus never share one. Within a
+ * manager, the lock is written by other cpus as well (see `slab_deallocate`), so it is kept
+ * apart from the sentinels which only the owner walks through.
+ */
 struct slab_manager {
     SpinLock lock;
-    SlabMetaData sentinels[SLAB_TYPES]; // regard slab as node in singly linked list,
-    // this line of code servers as an array of sentinel node for each slab type.
+    SlabMetaData sentinels[LIFETIMES][SLAB_TYPES] CACHE_ALIGNED; // regard slab as node in singly linked list,
+    // this line of code servers as an array of sentinel node for each lifetime and slab type.
+    // whether initial slabs of each type have been requested. They are populated lazily
+    // on the first allocation of that type, so that boot cost doesn't grow with cpu_count().
+    // Only short-lived sentinels have initial slabs.
+    int populated[SLAB_TYPES];
+    // pages that have been zeroed in advance, served to `kzalloc`.
+    int zeroed_count;
+    void *zeroed_pages[ZERO_POOL_CAPACITY];
+    // where slabs of this manager come from
+    struct memory_allocator *allocator;
+    // pointers waiting for their grace period to be freed in a batch, oldest first, see `kfree_deferred`.
+    SpinLock deferred_lock CACHE_ALIGNED;
+    int deferred_count;
+    struct deferred_entry deferred[DEFERRED_CAPACITY];
+    // the latest epoch of heap in which this cpu has passed a quiescent state
+    uint64_t quiescent_epoch;
+    // counters of tagged allocations made on this cpu, see `pmm_heap_tag_stats`.
+    struct pmm_tag_stats tag_stats[PMM_TAGS] CACHE_ALIGNED;
+    // live bytes of each tag this cpu has added since it last summed them up, only touched by this cpu
+    int64_t tag_drift[PMM_TAGS];
+#ifdef PMM_HARDENED
+    // a ring of freed pointers, the oldest is freed for real when it's full
+    SpinLock quarantine_lock CACHE_ALIGNED;
+    int quarantine_head, quarantine_count;
+    void *quarantine[PMM_QUARANTINE];
+    struct pmm_hardened_stats hardened_stats;
+#endif
+#ifdef PMM_LATENCY
+    // only written by the owner cpu, see `pmm_latency_percentile`
+    uint32_t latency[PMM_OPS][LATENCY_BUCKETS] CACHE_ALIGNED;
+#endif
+} CACHE_ALIGNED;
+
+/***** allocation flags **********/
+// the allocation may take pages below the min watermark, i.e. the emergency reserve.
+#define PMM_CRITICAL 0x1
+/* the allocation is expected to outlive most others. Its cells are kept in slabs of their own,
+   and its blocks are split off the top of free blocks, whereas short-lived ones take the bottom.
+   So short-lived slabs and blocks aren't pinned by a few long-lived objects among them. */
+#define PMM_LONG_LIVED 0x2
+/* the allocation gets no benefit from warm cache, e.g. bulk, DMA or zeroing. It's served from the
+   cold end of free lists. */
+#define PMM_COLD 0x4
+
+/***** heap **********************/
+/**
+ * an independent instance of the whole allocator: a buddy allocator plus a slab manager for
+ * each cpu. Different heaps manage disjoint ranges of memory and don't share any lock.
+ *     start                                                                      end
+ *     ********************************************************************************
+ *     * pmm_heap * slab_manager * ... * slab_manager * registry *  pages ...        *
+ *     ********************************************************************************
+ */
+struct pmm_heap;
+
+/**
+ * a callback which gives memory back to the heap under pressure, e.g. by shrinking a cache
+ * of some subsystem. It must neither allocate from the heap nor register another reclaimer.
+ * It's run without any lock of the heap held, and possibly on several cpus at once, so it must
+ * be thread-safe on its own.
+ * @return how many pages it has given back, approximately.
+ */
+typedef size_t (*pmm_reclaim_fn)(struct pmm_heap *heap, void *arg);
+
+#define RECLAIMERS 8
+
+struct pmm_reclaimer {
+    pmm_reclaim_fn fn;
+    void *arg;
 };
+
+struct pmm_heap {
+    struct memory_allocator mem;
+    struct slab_manager *managers; // the pointer to an array of slab managers
+    // reclaimers are registered under it, and copied under it before they are run
+    SpinLock reclaim_lock;
+    int reclaimer_count;
+    struct pmm_reclaimer reclaimers[RECLAIMERS];
+    // set while a cpu runs reclaimers for the low watermark, others don't pile up behind it
+    int reclaiming;
+    // soft quotas of live bytes of each tag, 0 means unlimited
+    size_t tag_quota[PMM_TAGS];
+    // live bytes of each tag over all cpus as last summed up, which is what quotas are checked against
+    int64_t tag_live[PMM_TAGS];
+    // the current epoch of grace periods, see `pmm_quiescent`
+    uint64_t epoch;
+};
+
+struct pmm_heap *pmm_heap_create(uintptr_t start, uintptr_t end);
+
+void *pmm_heap_alloc(struct pmm_heap *heap, size_t size);
+
+void *pmm_heap_alloc_flags(struct pmm_heap *heap, size_t size, int flags);
+
+void *kalloc_flags(size_t size, int flags);
+
+void *pmm_heap_alloc_aligned(struct pmm_heap *heap, size_t size, size_t align);
+
+void *kalloc_aligned(size_t size, size_t align);
+
+void pmm_heap_set_watermarks(struct pmm_heap *heap, size_t min_pages, size_t low_pages);
+
+void pmm_set_watermarks(size_t min_pages, size_t low_pages);
+
+int pmm_heap_register_reclaim(struct pmm_heap *heap, pmm_reclaim_fn fn, void *arg);
+
+int pmm_register_reclaim(pmm_reclaim_fn fn, void *arg);
+
+size_t pmm_heap_reclaim(struct pmm_heap *heap);
+
+void pmm_heap_free_tagged(struct pmm_heap *heap, void *ptr, int tag);
+
+void kfree_tagged(void *ptr, int tag);
+
+void pmm_heap_set_tag_quota(struct pmm_heap *heap, int tag, size_t bytes);
+
+void pmm_set_tag_quota(int tag, size_t bytes);
+
+void pmm_heap_tag_stats(struct pmm_heap *heap, int tag, struct pmm_tag_stats *stats);
+
+void pmm_tag_stats(int tag, struct pmm_tag_stats *stats);
+
+#ifdef PMM_HARDENED
+void pmm_heap_hardened_stats(struct pmm_heap *heap, struct pmm_hardened_stats *stats);
+
+void pmm_hardened_stats(struct pmm_hardened_stats *stats);
+#endif
+
+void pmm_heap_free(struct pmm_heap *heap, void *ptr);
+
+size_t pmm_heap_usable_size(struct pmm_heap *heap, void *ptr);
+
+size_t kalloc_usable_size(void *ptr);
+
+void pmm_heap_set_placement(struct pmm_heap *heap, enum placement placement);
+
+void pmm_set_placement(enum placement placement);
+
+void pmm_heap_set_lazy_threshold(struct pmm_heap *heap, int order, int threshold);
+
+void pmm_set_lazy_threshold(int order, int threshold);
+
+/***** fragmentation sample ********/
+/**
+ * a snapshot of how fragmented a heap is, taken by `pmm_heap_sample`. Sampling it periodically
+ * under churn shows how fast large blocks are lost.
+ */
+struct pmm_sample {
+    // free blocks of each order in MemAllocator, index <- order - base_order
+    int free_blocks[1 + 32 - 13];
+    // blocks cached in fast lists, which are not counted in free_blocks
+    int fast_blocks[FAST_ORDERS];
+    // the order of the largest free block; -1, if there is none
+    int largest_order;
+    // slab occupancy of each type, summed up over all cpus
+    int slabs[SLAB_TYPES];
+    int cells[SLAB_TYPES];
+    int used_cells[SLAB_TYPES];
+};
+
+void pmm_heap_sample(struct pmm_heap *heap, struct pmm_sample *sample);
+
+void pmm_sample(struct pmm_sample *sample);
+
+/***** snapshot ********************/
+/**
+ * the whole state of a heap serialized by `pmm_heap_snapshot`, all integers are little endian
+ * on the machines AM runs on and addresses are relative to `start`:
+ *     header      struct pmm_snapshot_header
+ *     free lists  for each order from base_order to max_order:
+ *                     uint32 count, uint64 address[count]
+ *     fast lists  for each of the fast_orders orders from base_order, in the same form
+ *     registry    uint8 entry[pages]
+ *     managers    for each cpu: uint32 populated[SLAB_TYPES], uint32 zeroed_count,
+ *                 uint32 deferred_count, and then for each lifetime and type:
+ *                     uint32 grow_pages, uint32 slabs, struct pmm_snapshot_slab[slabs],
+ *                     each followed by its bitmaps, bitmap[groups]
+ */
+#define PMM_SNAPSHOT_MAGIC 0x504d4d53 // "PMMS"
+#define PMM_SNAPSHOT_VERSION 2
+
+struct pmm_snapshot_header {
+    uint32_t magic, version;
+    uint32_t base_order, max_order;
+    uint64_t start, end;
+    uint32_t pages; // entries of registry
+    uint32_t cpus;
+    uint32_t slab_types, lifetimes;
+    uint32_t fast_orders; // since version 2
+    uint32_t reserved; // 0
+};
+
+struct pmm_snapshot_slab {
+    uint64_t address;
+    uint32_t status, type_size;
+    uint32_t groups, remaining;
+    uint32_t offset, color;
+};
+
+size_t pmm_heap_snapshot(struct pmm_heap *heap, void *buf, size_t len);
+
+size_t pmm_snapshot(void *buf, size_t len);
+
+/***** consistency check ***********/
+int pmm_heap_check(struct pmm_heap *heap);
+
+int pmm_check();
+
+void *kzalloc(size_t size);
+
+void pmm_refill_zero_pool();
+
+void pmm_idle();
+
+/***** deferred free **************/
+/**
+ * `kfree_deferred` frees ptr only after a grace period, so that readers which have found it
+ * without a lock, e.g. in a list it has just been unlinked from, can still read it. Grace
+ * periods are based on quiescent states: a cpu is quiescent where it holds no such reference.
+ * The contract is:
+ * - every cpu calls `pmm_quiescent` (or `pmm_idle`) at such points regularly, e.g. on every
+ *   context switch and in the idle loop. A cpu that never does holds back every queued pointer;
+ * - ptr is unreachable for new readers before it's queued;
+ * - once the queue of current cpu is full, `kfree_deferred` reports a quiescent state on its
+ *   behalf and waits for the other cpus. So, like synchronize_rcu, it must not be called from
+ *   a read-side section.
+ */
+void kfree_deferred(void *ptr);
+
+void pmm_quiescent();
+
+void pmm_drain_deferred();
+
+#ifdef PMM_LATENCY
+uint64_t pmm_latency_histogram(enum pmm_op op, uint64_t buckets[LATENCY_BUCKETS]);
+
+uint64_t pmm_latency_percentile(enum pmm_op op, int permille);
+
+void pmm_latency_reset();
+#endif
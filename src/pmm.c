@@ -12,9 +12,14 @@ const int SLAB_METADATA_MAGIC = 0x10101010;
 const int SLAB_CATEGORY[SLAB_TYPES] = {8, 16, 32, 64, 128};
 const int SLAB_INIT_PAGES_PER_TURN[SLAB_TYPES] = {5, 8, 5, 4, 3};
 const int SLAB_INIT_TURNS[SLAB_TYPES] = {1, 1, 3, 3, 4};
+// PMM_SLAB_FREELIST picks the mode of every type at once, e.g. for a build that measures it
+#ifndef PMM_SLAB_FREELIST
+#define PMM_SLAB_FREELIST 0
+#endif
+const int SLAB_FREELIST[SLAB_TYPES] = {PMM_SLAB_FREELIST, PMM_SLAB_FREELIST, PMM_SLAB_FREELIST,
+                                       PMM_SLAB_FREELIST, PMM_SLAB_FREELIST};
 
-static struct memory_allocator MemAllocator;
-struct slab_manager *SlabManagers; // the pointer to an array of slab managers
+static struct pmm_heap *DefaultHeap; // the heap behind `kalloc`, `kfree` and other pmm_* functions
 
 static int get_order(size_t size);
 
@@ -22,15 +27,47 @@ static size_t align_size(size_t size);
 
 static int calculate_buddyNum(uintptr_t addr, int order);
 
+static int private__fast_list_flush(struct memory_allocator *allocator);
+
+static int private__mem_coalesce(struct memory_allocator *allocator);
+
+// an internal flag of `private__mem_allocate_block`, on top of PMM_*: fail rather than flush
+// fast lists or coalesce, see `private__fast_alloc`.
+#define PMM_NO_FLUSH 0x80
+
+#ifdef PMM_HARDENED
+static void private__hardened_arm(struct pmm_heap *heap, void *ptr, size_t size);
+
+static int private__hardened_free(struct pmm_heap *heap, void **p_ptr);
+#endif
+
 int slab_get_typeIndex(size_t size);
 
 static int slab_isEmpty(const SlabMetaData *metaData);
 
-static void util_list_addFirst(int index, MemMetaData *target);
+static void util_list_addFirst(struct memory_allocator *allocator, int index, MemMetaData *target);
+
+static void util_list_addLast(struct memory_allocator *allocator, int index, MemMetaData *target);
 
-static MemMetaData *util_list_removeFirst(int index);
+static void util_list_add(struct memory_allocator *allocator, int index, MemMetaData *target, int cold);
 
-static MemMetaData *util_list_retrieve_with_metaAddr(int index, uintptr_t target_metaAddr);
+static MemMetaData *util_list_removeFirst(struct memory_allocator *allocator, int index);
+
+static MemMetaData *util_list_removeLast(struct memory_allocator *allocator, int index);
+
+static MemMetaData *util_list_retrieve_with_metaAddr(struct memory_allocator *allocator, int index,
+                                                     uintptr_t target_metaAddr);
+
+static uint8_t *util_registry(struct memory_allocator *allocator, uintptr_t addr);
+
+static int util_in_range(const struct memory_allocator *allocator, uintptr_t addr);
+
+static void util_tagged_push(struct memory_allocator *allocator, struct tagged_list *list, MemMetaData *target);
+
+static MemMetaData *util_tagged_pop(struct memory_allocator *allocator, struct tagged_list *list);
+
+static int util_tagged_walk(struct memory_allocator *allocator, struct tagged_list *list, int order,
+                            uintptr_t *addresses, int max);
 
 static int util_bitmap_has_space(bitmap b);
 
@@ -61,39 +98,297 @@ static uintptr_t private__mem_get_space_with_metaAddr(const uintptr_t metaAddr)
 MemMetaData *private__init_mem_metadata(const uintptr_t addr) {
     MemMetaData *meta = (MemMetaData *) addr;
     meta->MAGIC = MEM_METADATA_MAGIC;
-    meta->next = NULL;
+    meta->next = meta->prev = NULL;
     return meta;
 }
 
 /**
- * @brief initialize the global memory allocator, aka. `MemAllocator`.
+ * @brief initialize a memory allocator.
+ *
+ * The registry takes one byte per page and is placed at the beginning of the given space,
+ * so it only covers the pages of this allocator. Clearing it costs (endAddr - startAddr) / PAGE_SIZE
+ * bytes, rather than a fixed table that spans the whole address space.
  * @note parameters of this function may not be aligned
  */
-static void init_mem_allocator(uintptr_t startAddr, uintptr_t endAddr) {
-    lock_init(&MemAllocator.lock);
-    MemAllocator.base_order = 13;
+static void init_mem_allocator(struct memory_allocator *allocator, uintptr_t startAddr, uintptr_t endAddr) {
+    lock_init(&allocator->lock);
+    allocator->base_order = 13;
+    allocator->placement = PMM_PLACEMENT;
+    allocator->free_pages = 0;
+    allocator->watermark_low = allocator->watermark_min = 0;
 
     // truncate or align address to 'page size'
     endAddr = ROUNDDOWN(endAddr, PAGE_SIZE);
-    startAddr = ROUNDUP(startAddr, PAGE_SIZE);
-    MemMetaData *meta = private__init_mem_metadata(startAddr);
+    allocator->registry = (uint8_t *) startAddr;
+    const size_t entries = (endAddr - ROUNDUP(startAddr, PAGE_SIZE)) / PAGE_SIZE; // an upper bound
+    startAddr = ROUNDUP(startAddr + entries, PAGE_SIZE);
+    allocator->start = startAddr;
+    allocator->end = endAddr;
+
+    for (size_t i = 0; i < LENGTH(allocator->free_list); i++) {
+        allocator->free_list[i] = allocator->free_tail[i] = NULL;
+        allocator->free_count[i] = 0;
+        allocator->lazy_threshold[i] = 0;
+    }
+    for (int i = 0; i < FAST_ORDERS; i++) {
+        allocator->fast_list[i].head = 0;
+        allocator->fast_list[i].count = 0;
+    }
+    memset(allocator->registry, 0, entries);
+
+    /* the margin between startAddr and endAddr may not be 'power of two', nor is startAddr
+     * aligned to it. Carve the margin into naturally aligned blocks, that is, the address of
+     * every block is a multiple of its own size. `calculate_buddyNum` and `pmm_alloc_pages`
+     * both rely on this. */
+    const int capacity_order = allocator->base_order + LENGTH(allocator->free_list) - 1;
+    allocator->max_order = allocator->base_order;
+    while (startAddr < endAddr) {
+        int order = get_order(endAddr - startAddr);
+        const int align_order = __builtin_ctzl((unsigned long) startAddr);
+        if (align_order < order) order = align_order;
+        if (capacity_order < order) order = capacity_order;
+
+        util_list_add(allocator, order - allocator->base_order, private__init_mem_metadata(startAddr), 1);
+        if (order > allocator->max_order) allocator->max_order = order;
+        startAddr += (uintptr_t) 1 << order;
+    }
+}
+
+/**
+ * @brief take a block of exactly 2^order bytes out of free_list, splitting a bigger one if
+ * necessary, and register it.
+ * @note the address of the block is always a multiple of 2^order.
+ * @param flag set in registry along with the order
+ * @param flags PMM_* flags of the allocation
+ * @pre allocator->lock is held and base_order <= order.
+ * @return the address of the block (where its metadata used to be); NULL if there is no space.
+ */
+static uintptr_t private__mem_allocate_block(struct memory_allocator *allocator, const int order, const uint8_t flag,
+                                             const int flags) {
+    if (order > allocator->max_order) return (uintptr_t) NULL;
+    const size_t pages = (size_t) 1 << (order - allocator->base_order);
+    if (!(flags & PMM_CRITICAL) && allocator->free_pages < allocator->watermark_min + pages) {
+        // the rest is reserved for critical allocations
+        if (!(flags & PMM_NO_FLUSH) && private__fast_list_flush(allocator)) {
+            return private__mem_allocate_block(allocator, order, flag, flags);
+        }
+        return (uintptr_t) NULL;
+    }
+
+    int available_order = -1;
+    for (int o = order; o <= allocator->max_order; o++) {
+        if (allocator->free_list[o - allocator->base_order]) {
+            available_order = o;
+            break;
+        }
+    }
+    if (available_order == -1) {
+        // there is absolutely no space, unless some are left uncoalesced or cached in fast_list
+        if (!(flags & PMM_NO_FLUSH) && (private__mem_coalesce(allocator) || private__fast_list_flush(allocator))) {
+            return private__mem_allocate_block(allocator, order, flag, flags);
+        }
+        return (uintptr_t) NULL;
+    }
+    // split, nothing happens if the fitted space is available
+    MemMetaData *meta;
+    if (flags & PMM_LONG_LIVED) {
+        // the highest block, and keep the higher half on every split
+        const int index = available_order - allocator->base_order;
+        MemMetaData *highest = allocator->free_list[index];
+        for (MemMetaData *p = highest->next; p; p = p->next) {
+            if ((uintptr_t) p > (uintptr_t) highest) highest = p;
+        }
+        meta = util_list_retrieve_with_metaAddr(allocator, index, (uintptr_t) highest);
+        for (int o = available_order; o > order; o--) {
+            MemMetaData *lower = private__init_mem_metadata((uintptr_t) meta);
+            meta = (MemMetaData *) ((uintptr_t) meta + ((uintptr_t) 1 << (o - 1)));
+            util_list_add(allocator, o - 1 - allocator->base_order, lower, 1);
+        }
+        // the upper half has been in the middle of a block, it has no metadata of its own
+        meta = private__init_mem_metadata((uintptr_t) meta);
+    } else {
+        const int index = available_order - allocator->base_order;
+        if (flags & PMM_COLD && allocator->placement == PLACEMENT_LIFO) {
+            meta = util_list_removeLast(allocator, index);
+        } else {
+            meta = util_list_removeFirst(allocator, index);
+        }
+        // halves split off have never been touched since they were merged
+        for (int o = available_order; o > order; o--) {
+            const uintptr_t newAddr = (uintptr_t) meta + ((uintptr_t) 1 << (o - 1));
+            MemMetaData *newMeta = private__init_mem_metadata(newAddr);
+            util_list_add(allocator, o - 1 - allocator->base_order, newMeta, 1);
+        }
+    }
+    const uintptr_t addr = (uintptr_t) meta;
+    // registry of page blocks is changed without the lock on the way back, see `private__fast_free`
+    __atomic_store_n(util_registry(allocator, addr), flag | order, __ATOMIC_RELEASE);
+    return addr;
+}
+
+/**
+ * @brief give a block back to free_list and coalesce it with its buddies as far as possible.
+ * @pre allocator->lock is held and the block is not in any free list.
+ * @return how many times it has been merged.
+ */
+static int private__mem_merge_block(struct memory_allocator *allocator, MemMetaData *meta, int order) {
+    int merged = 0;
+    while (order < allocator->max_order) {
+        const uintptr_t this_buddyAddr = (uintptr_t) meta;
+        const int this_buddyNum = calculate_buddyNum(this_buddyAddr, order);
+        uintptr_t buddy_buddyAddr;
+        if (this_buddyNum) {
+            // this is right buddy (higher address) -> 1
+            buddy_buddyAddr = this_buddyAddr - ((uintptr_t) 1 << order);
+        } else {
+            // this is left buddy (lower address) -> 0
+            buddy_buddyAddr = this_buddyAddr + ((uintptr_t) 1 << order);
+        }
+
+        MemMetaData *buddyMeta = util_list_retrieve_with_metaAddr(allocator, order - allocator->base_order, buddy_buddyAddr);
+        if (!buddyMeta) break;
+        if (this_buddyNum) {
+            // right
+            meta = buddyMeta;
+        }
+        order++;
+        merged++;
+    }
+    private__init_mem_metadata((uintptr_t) meta);
+    // a merged block is mostly its buddies, which have been idle for a while
+    util_list_add(allocator, order - allocator->base_order, meta, merged > 0);
+    return merged;
+}
+
+/**
+ * @brief give a block back to free_list. It's coalesced right away, unless the free list of
+ * its order is shorter than the lazy threshold, see `private__mem_coalesce`.
+ * @pre allocator->lock is held and the block has been registered off.
+ */
+static void private__mem_free_block(struct memory_allocator *allocator, MemMetaData *meta, const int order) {
+    const int index = order - allocator->base_order;
+    if (allocator->free_count[index] < allocator->lazy_threshold[index]) {
+        private__init_mem_metadata((uintptr_t) meta);
+        util_list_add(allocator, index, meta, 0);
+        return;
+    }
+    private__mem_merge_block(allocator, meta, order);
+}
+
+/**
+ * @brief coalesce every block that has been left alone by the lazy buddy, from the lowest
+ * order to the highest, so that merged blocks take part in merging of the next order.
+ * @pre allocator->lock is held.
+ * @return how many times blocks have been merged, 0 means nothing changed.
+ */
+static int private__mem_coalesce(struct memory_allocator *allocator) {
+    int merged = 0;
+    for (int order = allocator->base_order; order < allocator->max_order; ++order) {
+        const int index = order - allocator->base_order;
+        if (!allocator->lazy_threshold[index]) continue;
+
+        MemMetaData *p = allocator->free_list[index];
+        allocator->free_list[index] = allocator->free_tail[index] = NULL;
+        const size_t pages = (size_t) allocator->free_count[index] << index;
+        __atomic_store_n(&allocator->free_pages, allocator->free_pages - pages, __ATOMIC_RELAXED);
+        allocator->free_count[index] = 0;
+        while (p) {
+            MemMetaData *next = p->next;
+            // the buddy is found only if it's been put back already, either way both of them
+            // end up merged once the latter one is put back.
+            merged += private__mem_merge_block(allocator, p, order);
+            p = next;
+        }
+    }
+    return merged;
+}
 
-    // the margin between startAddr and endAddr may not be 'power of two'
-    const int order = get_order(endAddr - startAddr);
-    MemAllocator.max_order = order;
+/**
+ * @brief give every block cached in fast_list back to free_list.
+ * @pre allocator->lock is held.
+ * @return the number of blocks given back.
+ */
+static int private__fast_list_flush(struct memory_allocator *allocator) {
+    int n = 0;
+    for (int i = 0; i < FAST_ORDERS; ++i) {
+        MemMetaData *meta;
+        while ((meta = util_tagged_pop(allocator, &allocator->fast_list[i]))) {
+            private__mem_free_block(allocator, meta, i + allocator->base_order);
+            n++;
+        }
+    }
+    return n;
+}
 
-    for (int i = 0; i < LENGTH(MemAllocator.free_list); i++) {
-        MemAllocator.free_list[i] = NULL;
+/**
+ * @brief lock-free page allocation for the smallest FAST_ORDERS orders.
+ *
+ * Only when fast_list runs dry, the lock is taken to move a batch of blocks from free_list
+ * into it. Splitting and coalescing stay under the lock.
+ * @param flags PMM_* flags of the allocation. Below the min watermark, cached blocks are left
+ * alone unless PMM_CRITICAL is given, so that the locked path can flush them into the reserve.
+ * @return the address of the block; NULL, if order isn't cached or there isn't available space.
+ */
+static uintptr_t private__fast_alloc(struct memory_allocator *allocator, const int order, const int flags) {
+    const int index = order - allocator->base_order;
+    if (index >= FAST_ORDERS) return (uintptr_t) NULL;
+    if (!(flags & PMM_CRITICAL) && __atomic_load_n(&allocator->free_pages, __ATOMIC_RELAXED)
+                                   < __atomic_load_n(&allocator->watermark_min, __ATOMIC_RELAXED)) {
+        return (uintptr_t) NULL;
     }
-    for (int i = 0; i < LENGTH(MemAllocator.registry); i++) {
-        MemAllocator.registry[i] = 0;
+
+    struct tagged_list *list = &allocator->fast_list[index];
+    MemMetaData *meta = util_tagged_pop(allocator, list);
+    if (!meta) {
+        /* refill, keep the first one for ourselves. The rest are pushed once the lock is released,
+           and taking them may neither flush fast lists nor coalesce, otherwise blocks of this very
+           batch would go straight back to free_list. */
+        uintptr_t batch[FAST_LIST_BATCH];
+        int n = 1;
+        lock_acquire(&allocator->lock);
+        batch[0] = private__mem_allocate_block(allocator, order, 0, flags & PMM_CRITICAL);
+        for (; batch[0] && n < FAST_LIST_BATCH; ++n) {
+            batch[n] = private__mem_allocate_block(allocator, order, 0, PMM_NO_FLUSH);
+            if (!batch[n]) break;
+            *util_registry(allocator, batch[n]) = 0;
+        }
+        lock_release(&allocator->lock);
+        if (!batch[0]) return (uintptr_t) NULL;
+        for (int i = 1; i < n; ++i) {
+            util_tagged_push(allocator, list, (MemMetaData *) batch[i]);
+        }
+        meta = (MemMetaData *) batch[0];
     }
+    const uintptr_t addr = (uintptr_t) meta;
+    __atomic_store_n(util_registry(allocator, addr), REGISTRY_PAGE | order, __ATOMIC_RELEASE);
+    return addr;
+}
 
-    MemAllocator.free_list[order - MemAllocator.base_order] = meta;
+/**
+ * @brief lock-free page deallocation for the smallest FAST_ORDERS orders.
+ * @return 0 if success; 1 if the block should go through the locked path instead, which is
+ * the case when order isn't cached, fast_list is full, or the block is invalid.
+ */
+static int private__fast_free(struct memory_allocator *allocator, const uintptr_t addr, const int order) {
+    const int index = order - allocator->base_order;
+    if (index < 0 || index >= FAST_ORDERS) return 1;
+    if (!util_in_range(allocator, addr) || addr % ((uintptr_t) 1 << order)) return 1;
+
+    struct tagged_list *list = &allocator->fast_list[index];
+    if (__atomic_load_n(&list->count, __ATOMIC_RELAXED) >= FAST_LIST_LIMIT) return 1;
+
+    // register off, which also makes sure a concurrent double free can't push it twice
+    uint8_t expected = REGISTRY_PAGE | order;
+    if (!__atomic_compare_exchange_n(util_registry(allocator, addr), &expected, 0, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    util_tagged_push(allocator, list, private__init_mem_metadata(addr));
+    return 0;
 }
 
 /**
- * @brief **private** function call of memory allocation in aid of MemAllocator
+ * @brief **private** function call of memory allocation in aid of memory allocator.
  * @param size the gross size that includes the metadata which controls the following space.
  * @note
  *  <li>  the requested size should be greater than a page.
@@ -102,57 +397,32 @@ static void init_mem_allocator(uintptr_t startAddr, uintptr_t endAddr) {
  * @return return NULL, if there isn't available space anymore
  * @link https://www.geeksforgeeks.org/buddy-memory-allocation-program-set-1-allocation/ @endlink
  */
-static uintptr_t private__mem_allocate(size_t size) {
+static uintptr_t private__mem_allocate(struct memory_allocator *allocator, size_t size, const int flags) {
     size = align_size(size);
     const int order = get_order(size);
 
-    if (MemAllocator.free_list[order - MemAllocator.base_order]) {
-        // fitted space is available
-        MemMetaData *meta = util_list_removeFirst(order - MemAllocator.base_order);
-        const uintptr_t addr = (uintptr_t) meta;
-        MemAllocator.registry[addr >> MemAllocator.base_order] = order;
-        return private__mem_get_space_with_metaAddr(addr);
-    }
-    // fitted space isn't available
-    int available_order = -1;
-    for (int o = order + 1; o <= MemAllocator.max_order; o++) {
-        if (MemAllocator.free_list[o - MemAllocator.base_order]) {
-            available_order = o;
-            break;
-        }
-    }
-    if (available_order == -1) {
-        // there is absolutely no space
-        return (uintptr_t) NULL;
-    }
-    // split
-    MemMetaData *meta = util_list_removeFirst(available_order - MemAllocator.base_order);
-    for (int o = available_order; o > order; o--) {
-        const uintptr_t newAddr = (uintptr_t) meta + (1 << (o - 1));
-        MemMetaData *newMeta = private__init_mem_metadata(newAddr);
-        util_list_addFirst(o - 1 - MemAllocator.base_order, newMeta);
-    }
-    const uintptr_t addr = (uintptr_t) meta;
-    MemAllocator.registry[addr >> MemAllocator.base_order] = order;
+    const uintptr_t addr = private__mem_allocate_block(allocator, order, 0, flags);
+    if (!addr) return (uintptr_t) NULL;
     return private__mem_get_space_with_metaAddr(addr);
 }
 
 /**
- * @brief **public** function call of memory allocation in aid of MemAllocator.
+ * @brief **public** function call of memory allocation in aid of memory allocator.
  * Middle layer between slab and actual 'memory allocator'
  * @param size the net size, not includes the metadata that controls the following space.
+ * @param flags PMM_* flags of the allocation
  * @warning the parameter should be greater than the maximum size of slab which is PAGE_SIZE
  * @return the address of requested space;
  * @return return NULL, if there isn't available space anymore.
  * @see the physical storage model in "common.h"
  */
-uintptr_t mem_allocate(size_t size) {
+uintptr_t mem_allocate(struct memory_allocator *allocator, size_t size, const int flags) {
     size = align_size(size);
     size_t *p_offset = NULL; // pointer to the offset.
-    lock_acquire(&MemAllocator.lock);
-    const uintptr_t space = private__mem_allocate(size + sizeof(MemMetaData) + sizeof(size_t));
+    lock_acquire(&allocator->lock);
+    const uintptr_t space = private__mem_allocate(allocator, size + sizeof(MemMetaData) + sizeof(size_t), flags);
     if (!space) {
-        lock_release(&MemAllocator.lock);
+        lock_release(&allocator->lock);
         return (uintptr_t) NULL;
     }
 
@@ -160,79 +430,353 @@ uintptr_t mem_allocate(size_t size) {
     // todo explain the potential error.
     p_offset = (size_t *) (beginning - sizeof(size_t));
     *p_offset = beginning - space;
-    lock_release(&MemAllocator.lock);
+    lock_release(&allocator->lock);
     return beginning;
 }
 
 /**
- * @brief **private** function call of memory deallocate in aid of MemAllocator.
+ * @brief **private** function call of memory deallocate in aid of memory allocator.
  * @param space in accordance with `__mem_allocate`, this parameter should be the
  * address of space rather than metadata.
  * @note address may not have been registered before, in this case, it is illegal.
- * Therefore, MemAllocator.registry as well as MAGIC should always be checked.
+ * Therefore, registry as well as MAGIC should always be checked.
  * @return 0 if success; 1 if failed
  * @link https://www.geeksforgeeks.org/buddy-memory-allocation-program-set-2-deallocation/ @endlink
  */
-int private__mem_deallocate(const uintptr_t space) {
+int private__mem_deallocate(struct memory_allocator *allocator, const uintptr_t space) {
     MemMetaData *meta = private__mem_get_metadata(space);
-    if (meta->MAGIC != MEM_METADATA_MAGIC) {
+    if (!util_in_range(allocator, (uintptr_t) meta) || meta->MAGIC != MEM_METADATA_MAGIC) {
         return 1;
     }
     const uintptr_t addr = (uintptr_t) meta;
-    int order = MemAllocator.registry[addr >> MemAllocator.base_order];
-    if (order < MemAllocator.base_order) {
+    int order = *util_registry(allocator, addr);
+    if (order < allocator->base_order || order & (REGISTRY_PAGE | REGISTRY_SLAB)) {
+        // not registered, handed out by `pmm_alloc_pages`, or within a slab
         return 1;
     }
-    MemAllocator.registry[addr >> MemAllocator.base_order] = 0; // register off
-
-    // coalesce
-    while (order < MemAllocator.max_order) {
-        const uintptr_t this_buddyAddr = (uintptr_t) meta;
-        const int this_buddyNum = calculate_buddyNum(this_buddyAddr, order);
-        uintptr_t buddy_buddyAddr;
-        if (this_buddyNum) {
-            // this is right buddy (higher address) -> 1
-            buddy_buddyAddr = this_buddyAddr - (1 << order);
-        } else {
-            // this is left buddy (lower address) -> 0
-            buddy_buddyAddr = this_buddyAddr + (1 << order);
-        }
+    *util_registry(allocator, addr) = 0; // register off
 
-        MemMetaData *buddyMeta = util_list_retrieve_with_metaAddr(order - MemAllocator.base_order, buddy_buddyAddr);
-        if (!buddyMeta) break;
-        if (this_buddyNum) {
-            // right
-            meta = buddyMeta;
-        }
-        order++;
-    }
-    util_list_addFirst(order - MemAllocator.base_order, meta);
+    private__mem_free_block(allocator, meta, order);
     return 0;
 }
 
 /**
- * @brief **public** function call of memory deallocate in aid of MemAllocator.
+ * @brief **public** function call of memory deallocate in aid of memory allocator.
  * use offset ahead of beginning to calculate address of space and simply pass it to private deallocate function.
  * @param beginning in accordance with `mem_allocate`, this parameter should be the
  * beginning of actual storage rather than metadata or space.
  * @return 0 if success; 1 if failed
  */
-int mem_deallocate(const uintptr_t beginning) {
+int mem_deallocate(struct memory_allocator *allocator, const uintptr_t beginning) {
     const size_t *p_offset = (size_t *) (beginning - sizeof(size_t));
     const uintptr_t space = beginning - *p_offset;
-    lock_acquire(&MemAllocator.lock);
-    const int ret = private__mem_deallocate(space);
-    lock_release(&MemAllocator.lock);
+    lock_acquire(&allocator->lock);
+    const int ret = private__mem_deallocate(allocator, space);
+    lock_release(&allocator->lock);
+    return ret;
+}
+
+/**
+ * @brief take a page block, i.e. registered with REGISTRY_PAGE, from fast_list if its order is
+ * cached there, or else from free_list under the lock.
+ * @param flags PMM_* flags. Long-lived and cold blocks bypass fast_list, as it holds blocks which
+ * have just been freed at the bottom of the heap.
+ * @return the address of the block; NULL, if there isn't available space anymore.
+ */
+static uintptr_t private__page_alloc(struct memory_allocator *allocator, const int order, const int flags) {
+    if (!(flags & (PMM_LONG_LIVED | PMM_COLD))) {
+        const uintptr_t addr = private__fast_alloc(allocator, order, flags);
+        if (addr) return addr;
+    }
+    lock_acquire(&allocator->lock);
+    const uintptr_t addr = private__mem_allocate_block(allocator, order, REGISTRY_PAGE, flags);
+    lock_release(&allocator->lock);
+    return addr;
+}
+
+/**
+ * @brief **public** function call of page allocation in aid of memory allocator.
+ *
+ * Unlike `mem_allocate`, the block comes straight from free_list, so neither MemMetaData
+ * nor offset is placed ahead of it. Consequently, the whole 2^order bytes are usable and
+ * the returned address is naturally aligned, i.e. a multiple of 2^order.
+ * @param order log2 of the requested size in bytes; raised to base_order if smaller.
+ * @return the address of the block; NULL, if there isn't available space anymore.
+ * @see pmm_free_pages
+ */
+void *pmm_alloc_pages(int order) {
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    if (order < allocator->base_order) order = allocator->base_order;
+    uintptr_t addr = private__page_alloc(allocator, order, 0);
+    if (!addr && pmm_heap_reclaim(DefaultHeap)) {
+        addr = private__page_alloc(allocator, order, 0);
+    }
+    return (void *) addr;
+}
+
+/**
+ * @brief **private** function call of page deallocation in aid of memory allocator.
+ * @note since there is no MAGIC, registry is the only thing to check against. It's registered
+ * off the same way as `private__fast_free` does, since that one doesn't take the lock.
+ * @pre allocator->lock is held.
+ * @return 0 if success; 1 if failed
+ */
+static int private__pmm_free_pages(struct memory_allocator *allocator, const uintptr_t addr, int order) {
+    if (order < allocator->base_order) order = allocator->base_order;
+    if (!util_in_range(allocator, addr) || addr % ((uintptr_t) 1 << order)) return 1;
+    uint8_t expected = REGISTRY_PAGE | order;
+    if (!__atomic_compare_exchange_n(util_registry(allocator, addr), &expected, 0, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    private__mem_free_block(allocator, (MemMetaData *) addr, order);
+    return 0;
+}
+
+/**
+ * @brief give a page block back, to fast_list if its order is cached there and it's not full,
+ * or else to free_list under the lock.
+ * @return same as `private__pmm_free_pages`.
+ */
+static int private__page_free(struct memory_allocator *allocator, const uintptr_t addr, const int order) {
+    if (!private__fast_free(allocator, addr, order)) return 0;
+
+    lock_acquire(&allocator->lock);
+    const int ret = private__pmm_free_pages(allocator, addr, order);
+    lock_release(&allocator->lock);
+    return ret;
+}
+
+/**
+ * @brief **public** function call of page deallocation in aid of memory allocator.
+ * @param ptr the address returned by `pmm_alloc_pages`.
+ * @param order the same order passed to `pmm_alloc_pages`.
+ * @return same as `private__pmm_free_pages`.
+ */
+int pmm_free_pages(void *ptr, const int order) {
+    return private__page_free(&DefaultHeap->mem, (uintptr_t) ptr, order);
+}
+
+/**
+ * @brief fast path for 2 MiB blocks, which back large-page mappings and DMA buffers.
+ * @see pmm_alloc_pages
+ */
+void *pmm_alloc_huge_page() {
+    return pmm_alloc_pages(HUGE_PAGE_ORDER);
+}
+
+int pmm_free_huge_page(void *ptr) {
+    return pmm_free_pages(ptr, HUGE_PAGE_ORDER);
+}
+
+/**
+ * @brief **public** function call of scatter/gather allocation in aid of memory allocator.
+ *
+ * The pages are not necessarily contiguous. In a single locked pass, this function takes
+ * the largest blocks that don't exceed what is still needed, so that bigger blocks are
+ * split only when no smaller one is left. Each block is then broken into pages, every
+ * one of which is registered on its own, exactly like `pmm_alloc_pages(base_order)` does.
+ * @param n the number of pages.
+ * @param pages the page vector which has at least n entries to be filled in.
+ * @return 0 if success; 1 if failed, in which case nothing is allocated. It fails as well if
+ * the pages would eat into the min watermark.
+ * @see pmm_free_page_vector
+ */
+int pmm_alloc_page_vector(const size_t n, void **pages) {
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    const int base = allocator->base_order;
+    size_t filled = 0;
+    lock_acquire(&allocator->lock);
+    // the rest is reserved for critical allocations, as in `private__mem_allocate_block`
+    if (allocator->free_pages < allocator->watermark_min + n) {
+        private__fast_list_flush(allocator);
+        if (allocator->free_pages < allocator->watermark_min + n) {
+            lock_release(&allocator->lock);
+            return 1;
+        }
+    }
+    while (filled < n) {
+        // the biggest order that doesn't exceed the remaining pages
+        int target = get_order(n - filled) + base;
+        if (target > allocator->max_order) target = allocator->max_order;
+
+        uintptr_t addr = (uintptr_t) NULL;
+        for (int o = target; o >= base; o--) {
+            if (allocator->free_list[o - base]) {
+                // pages in bulk are cold, so take them from the cold end
+                addr = (uintptr_t) (allocator->placement == PLACEMENT_LIFO ? util_list_removeLast(allocator, o - base)
+                                                                           : util_list_removeFirst(allocator, o - base));
+                target = o;
+                break;
+            }
+        }
+        if (!addr) {
+            // only bigger blocks are left, split one of them
+            addr = private__mem_allocate_block(allocator, target, REGISTRY_PAGE, PMM_COLD);
+        }
+        if (!addr) {
+            // roll back
+            for (size_t i = 0; i < filled; ++i) {
+                *util_registry(allocator, (uintptr_t) pages[i]) = 0;
+                private__mem_free_block(allocator, (MemMetaData *) pages[i], base);
+            }
+            lock_release(&allocator->lock);
+            return 1;
+        }
+        for (uintptr_t page = addr; page < addr + ((uintptr_t) 1 << target); page += PAGE_SIZE) {
+            __atomic_store_n(util_registry(allocator, page), REGISTRY_PAGE | base, __ATOMIC_RELEASE);
+            pages[filled++] = (void *) page;
+        }
+    }
+    lock_release(&allocator->lock);
+    return 0;
+}
+
+/**
+ * @brief **public** function call of bulk page deallocation in aid of memory allocator.
+ *
+ * All pages are given back under a single acquisition of the lock, and buddies among them
+ * coalesce as they do in `pmm_free_pages`.
+ * @param pages the page vector filled in by `pmm_alloc_page_vector`.
+ * @return 0 if success; 1 if any page is invalid, in which case the valid ones are still freed.
+ */
+int pmm_free_page_vector(void **pages, const size_t n) {
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    const int base = allocator->base_order;
+    int ret = 0;
+    lock_acquire(&allocator->lock);
+    for (size_t i = 0; i < n; ++i) {
+        if (private__pmm_free_pages(allocator, (uintptr_t) pages[i], base)) ret = 1;
+    }
+    lock_release(&allocator->lock);
     return ret;
 }
 
+/***** arena **********************/
+/**
+ * @brief initialize an empty arena. No memory is requested until the first allocation.
+ * @param chunk_size the usual size of chunks, rounded up to a power of two no less than PAGE_SIZE.
+ */
+void pmm_arena_init(struct pmm_arena *arena, const size_t chunk_size) {
+    arena->chunks = NULL;
+    arena->chunk_order = get_order(align_size(chunk_size));
+    if (arena->chunk_order < DefaultHeap->mem.base_order) arena->chunk_order = DefaultHeap->mem.base_order;
+}
+
+/**
+ * @brief request a chunk from the buddy allocator and link it into arena.
+ *
+ * The newest chunk is always the head, which is the only one being bumped. However, a chunk
+ * made for a single oversized request is linked behind the head so that the head keeps
+ * serving small requests.
+ * @return the new chunk; NULL if MemAllocator denies the request.
+ */
+static struct arena_chunk *private__arena_add_chunk(struct pmm_arena *arena, const int order) {
+    struct arena_chunk *chunk = pmm_alloc_pages(order);
+    if (!chunk) return NULL;
+
+    chunk->order = order;
+    chunk->end = (uintptr_t) chunk + ((uintptr_t) 1 << order);
+    chunk->top = ROUNDUP((uintptr_t) chunk + sizeof(struct arena_chunk), ARENA_ALIGN);
+    if (!arena->chunks || order == arena->chunk_order) {
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    } else {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+    }
+    return chunk;
+}
+
+/**
+ * @brief allocate from arena by bumping the pointer of the newest chunk.
+ * @note arena is not protected by any lock; it is meant to be owned by a single thread.
+ * @return the address aligned to ARENA_ALIGN; NULL, if there isn't available space anymore.
+ */
+void *pmm_arena_alloc(struct pmm_arena *arena, size_t size) {
+    size = ROUNDUP(size, ARENA_ALIGN);
+    struct arena_chunk *chunk = arena->chunks;
+    if (chunk && chunk->end - chunk->top >= size) {
+        // fast path
+        const uintptr_t ret = chunk->top;
+        chunk->top += size;
+        return (void *) ret;
+    }
+    const size_t header = ROUNDUP(sizeof(struct arena_chunk), ARENA_ALIGN);
+    int order = arena->chunk_order;
+    if (size + header > ((size_t) 1 << order)) {
+        order = get_order(align_size(size + header));
+    }
+    chunk = private__arena_add_chunk(arena, order);
+    if (!chunk) return NULL;
+
+    const uintptr_t ret = chunk->top;
+    chunk->top += size;
+    return (void *) ret;
+}
+
+/**
+ * @brief in hardened mode, poison what has been bumped out of chunk, so that objects used after
+ * the arena is reset or destroyed read PMM_POISON_BYTE. Chunks have no redzones.
+ */
+static void private__arena_poison(struct arena_chunk *chunk) {
+#ifdef PMM_HARDENED
+    const uintptr_t objects = ROUNDUP((uintptr_t) chunk + sizeof(struct arena_chunk), ARENA_ALIGN);
+    memset((void *) objects, PMM_POISON_BYTE, chunk->top - objects);
+#else
+    (void) chunk;
+#endif
+}
+
+/**
+ * @brief give every chunk of arena back to the buddy allocator under a single acquisition of
+ * the lock, except the newest one which is rewound and kept for reuse.
+ */
+void pmm_arena_reset(struct pmm_arena *arena) {
+    struct arena_chunk *kept = arena->chunks;
+    if (!kept) return;
+
+    for (struct arena_chunk *chunk = kept; chunk; chunk = chunk->next) {
+        private__arena_poison(chunk);
+    }
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    lock_acquire(&allocator->lock);
+    for (struct arena_chunk *chunk = kept->next, *next; chunk; chunk = next) {
+        next = chunk->next;
+        private__pmm_free_pages(allocator, (uintptr_t) chunk, chunk->order);
+    }
+    lock_release(&allocator->lock);
+    kept->next = NULL;
+    kept->top = ROUNDUP((uintptr_t) kept + sizeof(struct arena_chunk), ARENA_ALIGN);
+}
+
+/**
+ * @brief give every chunk of arena back to the buddy allocator under a single acquisition of
+ * the lock. The arena is empty afterwards and can be used again.
+ */
+void pmm_arena_destroy(struct pmm_arena *arena) {
+    for (struct arena_chunk *chunk = arena->chunks; chunk; chunk = chunk->next) {
+        private__arena_poison(chunk);
+    }
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    lock_acquire(&allocator->lock);
+    for (struct arena_chunk *chunk = arena->chunks, *next; chunk; chunk = next) {
+        next = chunk->next;
+        private__pmm_free_pages(allocator, (uintptr_t) chunk, chunk->order);
+    }
+    lock_release(&allocator->lock);
+    arena->chunks = NULL;
+}
+
 /**
  * Each slab is divided into multiple 'cells', where each cell is intended to
  * store a single instance of the object type that the slab manages.
  * The size of each cell is determined by the `typeSize` attribute.
  * <p>
- * Every time, this function is invoked, it first requests memory from the global
- * memory allocator which delivers a fit space. After setting up some attributes
+ * Every time, this function is invoked, it first requests a page block from the global
+ * memory allocator, which comes from its lock-free fast_list for the smallest orders. The
+ * slab takes the whole block, with neither MemMetaData nor offset ahead of it, and the block
+ * is naturally aligned, see `private__slab_get_metaData`. After setting up some attributes
  * of `struct slab_metadata`, it calculates how many bitmaps are suitable.
  * some useful equations are listed below:
  * - groups = number of bitmaps
@@ -248,41 +792,80 @@ int mem_deallocate(const uintptr_t beginning) {
  * else if status is `reusable`, place it at the rear.
  * The reason for this is that every time search available space from initial pages
  * to reusable pages, rather than randomly pick up one.
+ * <p>
+ * Lastly, slabs are colored. Since the layout of header and bitmaps is identical for every
+ * slab of a type, their first cells would otherwise all sit at the same page offset and hot
+ * cells of different slabs would compete for the same cache sets. Instead, the cells are
+ * moved towards the bitmaps by `color` cache lines, as long as the slack between them allows.
+ * Each new slab of a type takes the next color.
  *
- * @param size the total size requesting `MemAllocator`
+ * @param size the total size requesting `MemAllocator`, rounded up to a power of two.
+ * @param flags PMM_* flags of the allocation which causes this request
  * @note size must be multiple times of PAGE_SIZE.
  * @return the pointer to newMeta, if succeed; else, NULL.
  */
-SlabMetaData *slab_request_mem(SlabMetaData *sentinel, const Status status, const size_t size) {
-    SlabMetaData *newMeta = (SlabMetaData *) mem_allocate(size);
+SlabMetaData *slab_request_mem(struct memory_allocator *allocator, SlabMetaData *sentinel, const Status status,
+                               const size_t size, const int flags) {
+    const int order = get_order(align_size(size));
+    SlabMetaData *newMeta = (SlabMetaData *) private__page_alloc(allocator, order, flags);
     if (!newMeta) return NULL;
+    const uintptr_t end = (uintptr_t) newMeta + ((uintptr_t) 1 << order);
+    for (uintptr_t page = (uintptr_t) newMeta; page < end; page += PAGE_SIZE) {
+        __atomic_store_n(util_registry(allocator, page), REGISTRY_SLAB | order, __ATOMIC_RELEASE);
+    }
 
     newMeta->status = status;
     newMeta->typeSize = sentinel->typeSize;
+    newMeta->freelist = sentinel->freelist;
+    newMeta->lifetime = sentinel->lifetime;
+    newMeta->sentinel = sentinel;
     newMeta->MAGIC = SLAB_METADATA_MAGIC;
 
-    uintptr_t start = (uintptr_t) (newMeta + sizeof(SlabMetaData));
+    uintptr_t start = (uintptr_t) newMeta + sizeof(SlabMetaData);
     start = ROUNDUP(start, sizeof(bitmap));
     newMeta->p_bitmap = (bitmap *) start;
 
-    const uintptr_t end = (uintptr_t) (newMeta + size);
-    const int max_cell_num = (end - start) / newMeta->typeSize;
-    // dynamically partition bitmaps and cells.
-    int groups = 1;
-    for (int i = max_cell_num; i > 0; --i) {
-        const uintptr_t space = end - i * newMeta->typeSize; // the beginning of cell
-        groups = (int) ((space - start) / sizeof(bitmap));
-        const int capacity = groups * (int) (sizeof(bitmap) * 8);
-
-        if (capacity > i) break;
-    }
-    newMeta->groups = groups - 1; // guarantee capacity <= number of cells
+    // dynamically partition bitmaps and cells, `front` is where what lies ahead of cells ends.
+    // every group costs a bitmap plus (sizeof(bitmap) * 8) cells, which guarantees capacity <= number of cells
+#ifdef PMM_HARDENED
+    // as well as a requested size per cell, and the guard is taken once
+    const size_t group_size = sizeof(bitmap) + sizeof(bitmap) * 8 * (newMeta->typeSize + 1);
+    newMeta->groups = (int) ((end - start - PMM_REDZONE_GUARD) / group_size);
+    newMeta->remaining = (int) (newMeta->groups * (sizeof(bitmap) * 8));
+    newMeta->requested = (uint8_t *) (start + newMeta->groups * sizeof(bitmap));
+    memset(newMeta->requested, 0, newMeta->remaining);
+    const uintptr_t front = (uintptr_t) newMeta->requested + newMeta->remaining + PMM_REDZONE_GUARD;
+#else
+    const size_t group_size = sizeof(bitmap) + sizeof(bitmap) * 8 * newMeta->typeSize;
+    newMeta->groups = (int) ((end - start) / group_size);
     newMeta->remaining = (int) (newMeta->groups * (sizeof(bitmap) * 8));
-    newMeta->offset = (end - newMeta->remaining * newMeta->typeSize) - (uintptr_t) newMeta;
+    const uintptr_t front = start + newMeta->groups * sizeof(bitmap);
+#endif
+
+    // coloring. A step never breaks the alignment of cells to typeSize.
+    const uintptr_t cells = end - newMeta->remaining * newMeta->typeSize;
+    const uintptr_t slack = cells - front;
+    const int step = newMeta->typeSize > CACHE_LINE_SIZE ? newMeta->typeSize : CACHE_LINE_SIZE;
+    const int colors = (int) (slack / step) + 1;
+    newMeta->color = sentinel->color % colors;
+    sentinel->color = newMeta->color + 1;
+    newMeta->offset = cells - newMeta->color * step - (uintptr_t) newMeta;
+#ifdef PMM_HARDENED
+    memset((uint8_t *) newMeta + newMeta->offset - PMM_REDZONE_GUARD, PMM_REDZONE_BYTE, PMM_REDZONE_GUARD);
+#endif
     // initialize bitmaps
     for (int i = 0; i < newMeta->groups; ++i) {
         newMeta->p_bitmap[i] = 0;
     }
+    // chain up cells from lower to higher address
+    newMeta->free_cell = NULL;
+    if (newMeta->freelist) {
+        for (int i = newMeta->remaining - 1; i >= 0; --i) {
+            void **cell = (void **) ((uintptr_t) newMeta + newMeta->offset + i * newMeta->typeSize);
+            *cell = newMeta->free_cell;
+            newMeta->free_cell = cell;
+        }
+    }
 
     if (status == INITIAL) {
         newMeta->prev = sentinel;
@@ -301,18 +884,34 @@ SlabMetaData *slab_request_mem(SlabMetaData *sentinel, const Status status, cons
 /**
  * @brief Initializes the metadata for a SlabManager.
  *
- * This function first sets up sentinel node, and then request memory from the global
- * memory allocator.
+ * This function only sets up sentinel node. Initial slabs are no longer requested here,
+ * see `private__slab_populate`.
  */
-void private__init_slab_meta_data(SlabMetaData *sentinel, const int typeIndex) {
+void private__init_slab_meta_data(SlabMetaData *sentinel, const int lifetime, const int typeIndex) {
     sentinel->next = sentinel->prev = sentinel;
+    sentinel->sentinel = sentinel;
+    sentinel->lifetime = lifetime;
     sentinel->status = SENTINEL;
     sentinel->typeSize = SLAB_CATEGORY[typeIndex];
+    sentinel->freelist = SLAB_FREELIST[typeIndex];
     sentinel->MAGIC = SLAB_METADATA_MAGIC;
+    sentinel->color = 0;
+    sentinel->grow_pages = 1;
+    sentinel->allocs = 0;
+}
 
+/**
+ * @brief request the initial slabs of a single type from the memory allocator.
+ *
+ * This used to be done for every type of every cpu in `pmm_init`, which made boot cost
+ * grow with cpu_count() even if some types were never used. Now it is deferred until the
+ * first allocation of that type on that cpu.
+ * @pre the lock of the manager which owns this sentinel is held.
+ */
+static void private__slab_populate(struct memory_allocator *allocator, SlabMetaData *sentinel, const int typeIndex) {
     for (int i = 0; i < SLAB_INIT_TURNS[typeIndex]; ++i) {
-        slab_request_mem(sentinel, INITIAL,
-                         SLAB_INIT_PAGES_PER_TURN[typeIndex] * PAGE_SIZE); // mind here
+        slab_request_mem(allocator, sentinel, INITIAL,
+                         SLAB_INIT_PAGES_PER_TURN[typeIndex] * PAGE_SIZE, 0); // mind here
     }
 }
 
@@ -321,34 +920,110 @@ void private__init_slab_meta_data(SlabMetaData *sentinel, const int typeIndex) {
  *
  * The slab manager is responsible for managing a specific set of slabs,
  * each corresponding to a different object size.
+ * @param allocator where slabs of this manager come from.
  * @param addr The memory address where the slab manager is to be initialized.
  * @pre This address is expected to be properly aligned and allocated.
  */
-void private__init_slab_manager(const uintptr_t addr) {
+void private__init_slab_manager(struct memory_allocator *allocator, const uintptr_t addr) {
     struct slab_manager *manager = (struct slab_manager *) addr;
     lock_init(&manager->lock);
+    manager->allocator = allocator;
     for (int i = 0; i < SLAB_TYPES; ++i) {
-        private__init_slab_meta_data(&manager->sentinels[i], i);
+        for (int lifetime = 0; lifetime < LIFETIMES; ++lifetime) {
+            private__init_slab_meta_data(&manager->sentinels[lifetime][i], lifetime, i);
+        }
+        manager->populated[i] = 0;
     }
+    manager->zeroed_count = 0;
+    lock_init(&manager->deferred_lock);
+    manager->deferred_count = 0;
+    manager->quiescent_epoch = 0;
+    memset(manager->tag_stats, 0, sizeof(manager->tag_stats));
+    memset(manager->tag_drift, 0, sizeof(manager->tag_drift));
+#ifdef PMM_HARDENED
+    lock_init(&manager->quarantine_lock);
+    manager->quarantine_head = manager->quarantine_count = 0;
+    memset(&manager->hardened_stats, 0, sizeof(manager->hardened_stats));
+#endif
 }
 
 /**
- * @brief initialize an array of slab_managers, aka. `SlabManagers`.
+ * @brief initialize an array of slab_managers, aka. `heap->managers`.
  *
  * this function directly occupies physical memory to make room for each SlabManager.
  * @param p_startAddr a pointer to the start address
  * @note the start address of the available space is changed after this function call.
  */
-void init_slab_managers(uintptr_t *p_startAddr) {
-    uintptr_t start = ROUNDUP(*p_startAddr, sizeof(struct slab_manager));
-    SlabManagers = (struct slab_manager *) start;
+void init_slab_managers(struct pmm_heap *heap, uintptr_t *p_startAddr) {
+    // sizeof(struct slab_manager) is a multiple of CACHE_LINE_SIZE
+    uintptr_t start = ROUNDUP(*p_startAddr, CACHE_LINE_SIZE);
+    heap->managers = (struct slab_manager *) start;
     for (int i = 0; i < cpu_count(); ++i) {
-        private__init_slab_manager(start);
+        private__init_slab_manager(&heap->mem, start);
         start += sizeof(struct slab_manager);
     }
     *p_startAddr = start;
 }
 
+/**
+ * @brief take a free cell out of the given slab.
+ *
+ * In freelist mode, the head of embedded freelist is popped in O(1), and the bitmap is only
+ * updated for validation. Otherwise, bitmaps are scanned for the first zero bit.
+ * @pre metaData->remaining > 0 and the lock of its manager is held.
+ */
+static uintptr_t private__slab_take_cell(SlabMetaData *metaData) {
+    if (metaData->freelist) {
+        void **cell = metaData->free_cell;
+        metaData->free_cell = *cell;
+        metaData->remaining--;
+#ifndef NDEBUG
+        const int num = (int) (((uintptr_t) cell - ((uintptr_t) metaData + metaData->offset)) / metaData->typeSize);
+        bitmap *p_bitmap = &metaData->p_bitmap[num / (sizeof(bitmap) * 8)];
+        assert(!util_bitmap_test(*p_bitmap, num % (sizeof(bitmap) * 8)));
+        util_bitmap_flip_pos(p_bitmap, num % (sizeof(bitmap) * 8));
+#endif
+        return (uintptr_t) cell;
+    }
+    for (int g = 0; g < metaData->groups; ++g) {
+        if (!util_bitmap_has_space(metaData->p_bitmap[g]))continue;
+
+        const int pos = util_bitmap_get_available_pos(metaData->p_bitmap[g]);
+        util_bitmap_flip_pos(&metaData->p_bitmap[g], pos);
+        metaData->remaining--;
+        return (uintptr_t) metaData + metaData->offset +
+               (g * (sizeof(bitmap) * 8) + pos) * metaData->typeSize;
+    }
+    return (uintptr_t) NULL;
+}
+
+/**
+ * @brief request a REUSABLE slab whose size adapts to the observed demand.
+ *
+ * If the cells allocated since the last growth are no more than twice the capacity of that
+ * slab, it means the slabs are filled up rather than churned, i.e. the demand is sustained,
+ * so the size doubles up to SLAB_MAX_GROW_PAGES pages. It halves again whenever a slab turns
+ * out to be empty, see `slab_return_mem`. Therefore, bursty load hits MemAllocator less often,
+ * while idle types give memory back at a page granularity.
+ * @pre the lock of the manager which owns this sentinel is held.
+ * @return same as `slab_request_mem`.
+ */
+static SlabMetaData *private__slab_grow(struct memory_allocator *allocator, SlabMetaData *sentinel, const int flags) {
+    const int last_capacity = (int) (sentinel->grow_pages * PAGE_SIZE / sentinel->typeSize);
+    if (sentinel->allocs <= 2 * last_capacity && sentinel->grow_pages < SLAB_MAX_GROW_PAGES) {
+        sentinel->grow_pages <<= 1;
+    }
+    sentinel->allocs = 0;
+
+    SlabMetaData *newMeta = slab_request_mem(allocator, sentinel, REUSABLE, sentinel->grow_pages * PAGE_SIZE, flags);
+    if (!newMeta && sentinel->grow_pages > 1) {
+        // memory is tight, fall back to a single page
+        sentinel->grow_pages = 1;
+        newMeta = slab_request_mem(allocator, sentinel, REUSABLE, PAGE_SIZE, flags);
+    }
+    return newMeta;
+}
+
 /**
  * @brief **private** function call of slab allocation in aid of the dedicated slab manager.
  *
@@ -358,29 +1033,20 @@ void init_slab_managers(uintptr_t *p_startAddr) {
  * from MemAllocator; NULL if not available in current slab storage AND MemAllocator denies
  * the request.
  */
-uintptr_t private__slab_allocate(SlabMetaData *sentinel) {
+uintptr_t private__slab_allocate(struct memory_allocator *allocator, SlabMetaData *sentinel, const int flags) {
+    sentinel->allocs++;
     SlabMetaData *p = sentinel->next;
     while (p != sentinel) {
         if (p->remaining > 0) {
-            for (int g = 0; g < p->groups; ++g) {
-                if (!util_bitmap_has_space(p->p_bitmap[g]))continue;
-
-                const int pos = util_bitmap_get_available_pos(p->p_bitmap[g]);
-                util_bitmap_flip_pos(&p->p_bitmap[g], pos);
-                p->remaining--;
-                return (uintptr_t) p + p->offset +
-                       (g * (sizeof(bitmap) * 8) + pos) * p->typeSize;
-            }
+            return private__slab_take_cell(p);
         }
         p = p->next;
     }
-    // no available space in current list of slabs, request a page once.
-    SlabMetaData *newMeta = slab_request_mem(sentinel, REUSABLE, PAGE_SIZE);
+    // no available space in current list of slabs, grow.
+    SlabMetaData *newMeta = private__slab_grow(allocator, sentinel, flags);
     if (!newMeta) return (uintptr_t) NULL;
 
-    newMeta->remaining--;
-    util_bitmap_flip_pos(newMeta->p_bitmap, 0);
-    return (uintptr_t) newMeta + newMeta->offset;
+    return private__slab_take_cell(newMeta);
 }
 
 /**
@@ -388,148 +1054,1531 @@ uintptr_t private__slab_allocate(SlabMetaData *sentinel) {
  * @return same as `__slab_allocate`.
  * @see private__slab_allocate for more details.
  */
-uintptr_t slab_allocate(struct slab_manager *manager, const int typeIndex) {
+uintptr_t slab_allocate(struct slab_manager *manager, const int typeIndex, const int flags) {
     lock_acquire(&manager->lock);
-    const int ret = private__slab_allocate(&manager->sentinels[typeIndex]);
+    const int lifetime = flags & PMM_LONG_LIVED ? 1 : 0;
+    if (!lifetime && !manager->populated[typeIndex]) {
+        // first use of this type on this cpu
+        private__slab_populate(manager->allocator, &manager->sentinels[0][typeIndex], typeIndex);
+        manager->populated[typeIndex] = 1;
+    }
+    const uintptr_t ret = private__slab_allocate(manager->allocator, &manager->sentinels[lifetime][typeIndex], flags);
     lock_release(&manager->lock);
     return ret;
 }
 
-static void *kalloc(size_t size) {
-    if (size > MAX_REQUEST_MEM) return NULL;
-
+/**
+ * @brief allocate from the given heap, by the slab manager of current cpu if the size fits
+ * in slab, or else by the memory allocator.
+ * @pre size <= MAX_REQUEST_MEM, plus PMM_REDZONE_MIN in hardened mode.
+ * @return the address of requested space; NULL, if there isn't available space anymore.
+ */
+static void *private__heap_alloc(struct pmm_heap *heap, size_t size, const int flags) {
     void *ret = NULL;
     const int typeIndex = slab_get_typeIndex(size);
     if (typeIndex >= 0) {
         // suitable for slab
         const int cpu = cpu_current();
-        ret = (void *) slab_allocate(&SlabManagers[cpu], typeIndex);
+        ret = (void *) slab_allocate(&heap->managers[cpu], typeIndex, flags);
     } else {
         // too big for slab
         /* adjust the size to bigger or equal to PAGE_SIZE to fit in with `mem_allocate`.
          Admittedly, this is a kind of waste if SLAB_CATEGORY[-1] < size < PAGE_SIZE */
         size = size >= PAGE_SIZE ? size : PAGE_SIZE;
-        ret = (void *) mem_allocate(size);
+        ret = (void *) mem_allocate(&heap->mem, size, flags);
     }
     return ret;
 }
 
 /**
- * @brief get SlabMetaData using the given address.
+ * @brief `private__heap_alloc`, which runs reclaimers if it fails and retries once, or if free
+ * pages have dropped below the low watermark.
+ */
+static void *private__heap_alloc_reclaim(struct pmm_heap *heap, const size_t size, const int flags) {
+    void *ret = private__heap_alloc(heap, size, flags);
+    if (!ret) {
+        if (pmm_heap_reclaim(heap)) ret = private__heap_alloc(heap, size, flags);
+    } else if (__atomic_load_n(&heap->mem.free_pages, __ATOMIC_RELAXED)
+               < __atomic_load_n(&heap->mem.watermark_low, __ATOMIC_RELAXED)
+               && !__atomic_exchange_n(&heap->reclaiming, 1, __ATOMIC_ACQUIRE)) {
+        pmm_heap_reclaim(heap);
+        __atomic_store_n(&heap->reclaiming, 0, __ATOMIC_RELEASE);
+    }
+    return ret;
+}
+
+/**
+ * @brief sum up live bytes of the given tag over all cpus and keep the sum in pmm_heap.tag_live
+ * for quota checks of every cpu, so that the drift of current cpu starts over.
+ * @return the sum.
+ */
+static int64_t private__tag_sum(struct pmm_heap *heap, const int tag) {
+    int64_t live = 0;
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        live += __atomic_load_n(&heap->managers[cpu].tag_stats[tag].live_bytes, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&heap->tag_live[tag], live, __ATOMIC_RELAXED);
+    heap->managers[cpu_current()].tag_drift[tag] = 0;
+    return live;
+}
+
+/**
+ * @brief account bytes, which are negative for a free, to the given tag on current cpu. Every
+ * PMM_TAG_REFRESH allocations and frees of the tag on this cpu, the sum is taken again.
+ */
+static void private__tag_account(struct pmm_heap *heap, const int tag, const int64_t bytes) {
+    struct slab_manager *manager = &heap->managers[cpu_current()];
+    struct pmm_tag_stats *stats = &manager->tag_stats[tag];
+    __atomic_fetch_add(&stats->live_bytes, bytes, __ATOMIC_RELAXED);
+    manager->tag_drift[tag] += bytes;
+    if ((stats->allocs + stats->frees) % PMM_TAG_REFRESH == 0) private__tag_sum(heap, tag);
+}
+
+/**
+ * @brief same as `pmm_heap_alloc`, but it takes PMM_* flags.
  *
- * Since slab's cells don't possess offsets simliar to ones prefixed ahead of space
- * in memory, otherwise, it is handy to calculate the address of metadata using offset.
- * Therefore, I came up with this roundabout approach: try all the possibilities.
+ * Under pressure, caches are shrunk rather than failing the allocation: reclaimers are run if
+ * it fails, after which it's retried once; they are also run if free pages have dropped below
+ * the low watermark, unless another cpu is running them for the same reason already, see
+ * pmm_heap.reclaiming.
  * <p>
- * During the initiation stage, different slab typeSizes are allocated with predefined
- * sizes as listed in SLAB_CATEGORY. So this is relativly easy to look up. Meanwhile,
- * during the allocation stage, all sizes requested to memory were identical which
- * is PAGE_SIZE with certainty.
- * @param addr which is possible within the scope of slabs.
- * @return slab metadata, if it is likely that this address is within the scope of slabs;
- * else, NULL;
+ * If a tag is given by PMM_TAG, the usable size is accounted to it on current cpu. Once the live
+ * bytes of the tag would exceed its quota, allocations without PMM_CRITICAL are refused. The
+ * quota is checked against pmm_heap.tag_live plus what current cpu has added since, and the
+ * exact sum is taken only before refusing, so no shared counter is written on every call. The
+ * quota is soft, as other cpus may be up to PMM_TAG_REFRESH allocations ahead of the sum.
  */
-SlabMetaData *private__slab_get_metaData(const uintptr_t addr) {
-    SlabMetaData *meta = (SlabMetaData *) ROUNDDOWN(addr, PAGE_SIZE);
-    if (meta->MAGIC == SLAB_METADATA_MAGIC) {
-        return meta;
+void *pmm_heap_alloc_flags(struct pmm_heap *heap, const size_t size, const int flags) {
+    if (size > MAX_REQUEST_MEM) return NULL;
+    const int tag = flags >> PMM_TAG_SHIFT;
+    struct pmm_tag_stats *stats = NULL;
+    if (tag > 0 && tag < PMM_TAGS) {
+        struct slab_manager *manager = &heap->managers[cpu_current()];
+        stats = &manager->tag_stats[tag];
+        const int64_t quota = (int64_t) __atomic_load_n(&heap->tag_quota[tag], __ATOMIC_RELAXED);
+        if (quota && !(flags & PMM_CRITICAL)) {
+            int64_t live = __atomic_load_n(&heap->tag_live[tag], __ATOMIC_RELAXED) + manager->tag_drift[tag];
+            if (live + (int64_t) size > quota) live = private__tag_sum(heap, tag);
+            if (live + (int64_t) size > quota) {
+                __atomic_fetch_add(&stats->refused, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+        }
     }
-    for (int i = 0; i < SLAB_TYPES; ++i) {
-        meta = (SlabMetaData *) ROUNDDOWN(addr, PAGE_SIZE * SLAB_INIT_PAGES_PER_TURN[i]);
-        if (meta->MAGIC == SLAB_METADATA_MAGIC) return meta;
+
+#ifdef PMM_HARDENED
+    // room for a trailing redzone, even if size is exactly that of a type or a power of two
+    void *ret = private__heap_alloc_reclaim(heap, size + PMM_REDZONE_MIN, flags);
+    if (ret) private__hardened_arm(heap, ret, size);
+#else
+    void *ret = private__heap_alloc_reclaim(heap, size, flags);
+#endif
+    if (ret && stats) {
+        __atomic_fetch_add(&stats->allocs, 1, __ATOMIC_RELAXED);
+        private__tag_account(heap, tag, (int64_t) pmm_heap_usable_size(heap, ret));
+    }
+    return ret;
+}
+
+void *pmm_heap_alloc(struct pmm_heap *heap, const size_t size) {
+    return pmm_heap_alloc_flags(heap, size, 0);
+}
+
+void *kalloc_flags(const size_t size, const int flags) {
+    return pmm_heap_alloc_flags(DefaultHeap, size, flags);
+}
+
+/**
+ * @brief allocate at least size bytes aligned to align, from the given heap.
+ *
+ * `mem_allocate` aligns the space to its own rounded size at the cost of a block twice as big,
+ * in order to hold MemMetaData and offset ahead of it. Here neither is needed:
+ * - if max(size, align) fits in slab, a cell of that type is aligned to its typeSize, which
+ *   is a power of two;
+ * - otherwise, it's a page block whose order is kept in registry only, the same as
+ *   `pmm_alloc_pages`. The block is naturally aligned, so it takes just the rounded size.
+ * Either way, it's given back by `pmm_heap_free`. In hardened mode, size is padded as it is by
+ * `pmm_heap_alloc_flags`, and page blocks, which have no room for a redzone, aren't used. A
+ * block from `mem_allocate` takes their place, which is aligned to its rounded size as well.
+ * @param align a power of two, up to 2^max_order.
+ * @return the address of requested space; NULL, if there isn't available space anymore or
+ * align is invalid.
+ */
+void *pmm_heap_alloc_aligned(struct pmm_heap *heap, const size_t size, const size_t align) {
+    struct memory_allocator *allocator = &heap->mem;
+    if (!align || align & (align - 1) || size > MAX_REQUEST_MEM) return NULL;
+
+#ifdef PMM_HARDENED
+    const size_t fit = size + PMM_REDZONE_MIN > align ? size + PMM_REDZONE_MIN : align;
+    // `mem_allocate` takes twice the rounded size
+    if (fit > PAGE_SIZE && get_order(align_size(fit)) >= allocator->max_order) return NULL;
+    // the redzone begins right behind the requested size, rather than the alignment
+    void *ret = private__heap_alloc_reclaim(heap, fit, 0);
+    if (ret) private__hardened_arm(heap, ret, size);
+    return ret;
+#else
+    const size_t fit = size > align ? size : align;
+    if (slab_get_typeIndex(fit) >= 0) return private__heap_alloc_reclaim(heap, fit, 0);
+    int order = get_order(align_size(fit));
+    if (order < allocator->base_order) order = allocator->base_order;
+    if (order > allocator->max_order) return NULL;
+
+    for (int turn = 0; turn < 2; ++turn) {
+        const uintptr_t addr = private__page_alloc(allocator, order, 0);
+        if (addr) return (void *) addr;
+        // reclaim once before failing
+        if (turn == 0 && !pmm_heap_reclaim(heap)) break;
     }
     return NULL;
+#endif
+}
+
+void *kalloc_aligned(const size_t size, const size_t align) {
+    return pmm_heap_alloc_aligned(DefaultHeap, size, align);
+}
+
+#ifdef PMM_LATENCY
+static void private__latency_record(const enum pmm_op op, const uint64_t ticks) {
+    const int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+    DefaultHeap->managers[cpu_current()].latency[op][bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+}
+#endif
+
+static void *kalloc(size_t size) {
+#ifdef PMM_LATENCY
+    const uint64_t begin = PMM_CLOCK();
+    void *ret = pmm_heap_alloc(DefaultHeap, size);
+    private__latency_record(PMM_OP_ALLOC, PMM_CLOCK() - begin);
+    return ret;
+#else
+    return pmm_heap_alloc(DefaultHeap, size);
+#endif
+}
+
+/**
+ * @brief allocate zeroed memory.
+ *
+ * Requests that are too big for slab but fit in a page are served by the pre-zeroed pages of
+ * current cpu, so that zeroing is mostly moved off the critical path. Otherwise, or if the
+ * pool runs dry, it falls back to allocating and zeroing in place. In hardened mode, every
+ * request is allocated and zeroed in place, so that it gets a redzone.
+ * @see pmm_refill_zero_pool
+ */
+void *kzalloc(size_t size) {
+#ifndef PMM_HARDENED
+    if (size > (size_t) SLAB_CATEGORY[SLAB_TYPES - 1] && size <= PAGE_SIZE) {
+        struct slab_manager *manager = &DefaultHeap->managers[cpu_current()];
+        void *page = NULL;
+        lock_acquire(&manager->lock);
+        if (manager->zeroed_count > 0) {
+            page = manager->zeroed_pages[--manager->zeroed_count];
+        }
+        lock_release(&manager->lock);
+        if (page) return page;
+
+        page = pmm_alloc_pages(DefaultHeap->mem.base_order);
+        if (page) memset(page, 0, PAGE_SIZE);
+        return page;
+    }
+#endif
+    void *ret = kalloc_flags(size, PMM_COLD);
+    if (ret) memset(ret, 0, size);
+    return ret;
+}
+
+/**
+ * @brief fill the pre-zeroed page pool of current cpu up to ZERO_POOL_CAPACITY.
+ *
+ * This is meant to be called during idle time. Pages are zeroed without holding any lock;
+ * the lock of slab manager is taken only for pushing each of them.
+ */
+void pmm_refill_zero_pool() {
+#ifdef PMM_HARDENED
+    // pool pages have no room for a redzone, so `kzalloc` never takes them
+    return;
+#endif
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    struct slab_manager *manager = &DefaultHeap->managers[cpu_current()];
+    while (manager->zeroed_count < ZERO_POOL_CAPACITY) {
+        // the pool is a cache as well, don't fill it under pressure, nor reclaim for it
+        if (__atomic_load_n(&allocator->free_pages, __ATOMIC_RELAXED)
+            < __atomic_load_n(&allocator->watermark_low, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // pages are about to be overwritten anyway, so leave warm ones to others
+        lock_acquire(&allocator->lock);
+        void *page = (void *) private__mem_allocate_block(allocator, allocator->base_order, REGISTRY_PAGE, PMM_COLD);
+        lock_release(&allocator->lock);
+        if (!page) return;
+        memset(page, 0, PAGE_SIZE);
+
+        lock_acquire(&manager->lock);
+        if (manager->zeroed_count < ZERO_POOL_CAPACITY) {
+            manager->zeroed_pages[manager->zeroed_count++] = page;
+            page = NULL;
+        }
+        lock_release(&manager->lock);
+        if (page) {
+            pmm_free_pages(page, DefaultHeap->mem.base_order);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief the work that current cpu can do for pmm when it has nothing else to run.
+ *
+ * It's meant to be called from the idle loop of each cpu, which is a quiescent state as well.
+ * It refills the pre-zeroed page pool, which is otherwise only drained by `kzalloc`, and frees
+ * deferred pointers whose grace period has elapsed.
+ */
+void pmm_idle() {
+    pmm_quiescent();
+    pmm_refill_zero_pool();
+}
+
+/**
+ * @brief get SlabMetaData using the given address.
+ *
+ * Slab's cells don't possess offsets similar to ones prefixed ahead of space in memory.
+ * Instead, every page of a slab is marked in registry with REGISTRY_SLAB and the order the
+ * slab is aligned to, see `slab_request_mem`. So it's a single lookup, and user data which
+ * happens to look like SLAB_METADATA_MAGIC can't be mistaken for metadata.
+ * @param addr which is possible within the scope of slabs.
+ * @return slab metadata, if this address is within the scope of slabs; else, NULL;
+ */
+static SlabMetaData *private__slab_get_metaData(struct memory_allocator *allocator, const uintptr_t addr) {
+    if (!util_in_range(allocator, addr)) return NULL;
+
+    const uint8_t registered = *util_registry(allocator, addr);
+    if (!(registered & REGISTRY_SLAB)) return NULL;
+    return (SlabMetaData *) ROUNDDOWN(addr, (uintptr_t) 1 << (registered & ~REGISTRY_SLAB));
 }
 
 /**
- * @brief return space to the global memory allocator.
+ * @brief return space to the memory allocator.
  * @see `slab_deallocate`.
  */
-void slab_return_mem(SlabMetaData *metaData) {
+void slab_return_mem(struct memory_allocator *allocator, SlabMetaData *metaData) {
     if (metaData->status != REUSABLE) return;
 
+    SlabMetaData *sentinel = metaData->sentinel;
+    // demand has dropped, shrink the next growth
+    if (sentinel->grow_pages > 1) sentinel->grow_pages >>= 1;
+
     SlabMetaData *p = metaData->prev;
     SlabMetaData *n = metaData->next;
     p->next = n;
     n->prev = p;
     metaData->prev = metaData->next = NULL;
-    mem_deallocate((uintptr_t) metaData);
+    const int order = *util_registry(allocator, (uintptr_t) metaData) & ~REGISTRY_SLAB;
+    const uintptr_t end = (uintptr_t) metaData + ((uintptr_t) 1 << order);
+    for (uintptr_t page = (uintptr_t) metaData + PAGE_SIZE; page < end; page += PAGE_SIZE) {
+        __atomic_store_n(util_registry(allocator, page), 0, __ATOMIC_RELEASE);
+    }
+    // it's a page block again, as handed out to `slab_request_mem`
+    __atomic_store_n(util_registry(allocator, (uintptr_t) metaData), REGISTRY_PAGE | order, __ATOMIC_RELEASE);
+    private__page_free(allocator, (uintptr_t) metaData, order);
 }
 
-static struct slab_manager *private__slab_get_manager_with_sentinel(SlabMetaData *sentinel) {
-    return (struct slab_manager *) ROUNDDOWN((uintptr_t)sentinel, sizeof(struct slab_manager));
+/**
+ * @brief get the slab manager that the given sentinel belongs to.
+ * @param typeIndex the index of sentinel in `sentinels[sentinel->lifetime]`.
+ */
+static struct slab_manager *private__slab_get_manager_with_sentinel(SlabMetaData *sentinel, const int typeIndex) {
+    return (struct slab_manager *) ((uintptr_t) sentinel - offsetof(struct slab_manager, sentinels)
+                                    - (sentinel->lifetime * SLAB_TYPES + typeIndex) * sizeof(SlabMetaData));
 }
 
 /**
- * @brief **public** function call of slab deallocate.
- * This function first exercises sanity check and then clears the bit as well as reduces
- * remaining. When this slab is empty, it calls `slab_return_mem` which gives back the
- * space to memory if this slab has been marked as REUSABLE.
- * @return 0 if succeed; 1 failed.
+ * @brief sanity check before giving a cell back to its slab.
+ * @return the slab manager that owns this slab, if the cell is valid and allocated; else, NULL.
  */
-int slab_deallocate(SlabMetaData *meta, const uintptr_t targetAddr) {
-    if (meta->MAGIC != SLAB_METADATA_MAGIC || meta->status == SENTINEL) return 1;
+static struct slab_manager *private__slab_check(SlabMetaData *meta, const uintptr_t targetAddr) {
+    if (meta->MAGIC != SLAB_METADATA_MAGIC || meta->status == SENTINEL) return NULL;
 
     const int typeIndex = slab_get_typeIndex(meta->typeSize);
     if (typeIndex < 0 || meta->typeSize != SLAB_CATEGORY[typeIndex]) {
         // not the exact size
-        return 1;
+        return NULL;
     }
     if (targetAddr % meta->typeSize) {
         // not aligned
-        return 1;
+        return NULL;
     }
-    if (meta->groups <= 0) return 1;
+    if (meta->groups <= 0) return NULL;
 
     const size_t distance = targetAddr - ((uintptr_t) meta + meta->offset);
-    const int num = distance / meta->typeSize;
-    const int g = num / (sizeof(bitmap) * 8);
-    if (g < 0 || g >= meta->groups) return 1;
+    const size_t num = distance / meta->typeSize;
+    const size_t g = num / (sizeof(bitmap) * 8);
+    if (g >= (size_t) meta->groups) return NULL;
 
-    const int pos = num % (sizeof(bitmap) * 8);
-    if (pos < 0 || pos >= sizeof(bitmap) * 8) return 1;
+    const size_t pos = num % (sizeof(bitmap) * 8);
 
+#ifdef NDEBUG
+    // bitmaps aren't maintained in freelist mode
+    if (!meta->freelist && !util_bitmap_test(meta->p_bitmap[g], pos)) {
+#else
     if (!util_bitmap_test(meta->p_bitmap[g], pos)) {
+#endif
         // the target bit is 0
-        return 1;
+        return NULL;
     }
 
-    SlabMetaData *sentinel = meta;
-    while (sentinel->status != SENTINEL) {
-        sentinel = sentinel->next;
+    SlabMetaData *sentinel = meta->sentinel;
+    if (sentinel->status != SENTINEL || sentinel->typeSize != meta->typeSize) return NULL;
+    return private__slab_get_manager_with_sentinel(sentinel, typeIndex);
+}
+
+/**
+ * @brief `private__slab_check` again once the lock of manager is held. In the meantime, another
+ * cpu may have released the same cell, e.g. if it's freed twice at once, and its slab may even
+ * have been given back.
+ * @pre the lock of manager is held.
+ * @return 1 if the cell can still be released by manager; else, 0.
+ */
+static int private__slab_recheck(struct slab_manager *manager, SlabMetaData *meta, const uintptr_t targetAddr) {
+    return meta && private__slab_get_metaData(manager->allocator, targetAddr) == meta &&
+           private__slab_check(meta, targetAddr) == manager;
+}
+
+/**
+ * @brief clear the bit (or push the cell onto freelist) as well as reduce remaining. When this
+ * slab is empty, it calls `slab_return_mem`.
+ * @pre `private__slab_check` has passed and the lock of its manager is held.
+ */
+static void private__slab_release_cell(struct slab_manager *manager, SlabMetaData *meta, const uintptr_t targetAddr) {
+    const int num = (int) ((targetAddr - ((uintptr_t) meta + meta->offset)) / meta->typeSize);
+    const int g = num / (sizeof(bitmap) * 8);
+    const int pos = num % (sizeof(bitmap) * 8);
+    if (meta->freelist) {
+        void **cell = (void **) targetAddr;
+        *cell = meta->free_cell;
+        meta->free_cell = cell;
+#ifndef NDEBUG
+        util_bitmap_flip_pos(&meta->p_bitmap[g], pos);
+#endif
+    } else {
+        util_bitmap_flip_pos(&meta->p_bitmap[g], pos);
     }
-    struct slab_manager *manager = private__slab_get_manager_with_sentinel(sentinel);
-    lock_acquire(&manager->lock);
-    util_bitmap_flip_pos(&meta->p_bitmap[g], pos);
     meta->remaining++;
     if (slab_isEmpty(meta)) {
-        slab_return_mem(meta);
+        slab_return_mem(manager->allocator, meta);
     }
+}
+
+/**
+ * @brief **public** function call of slab deallocate.
+ * This function first exercises sanity check and then clears the bit as well as reduces
+ * remaining. When this slab is empty, it calls `slab_return_mem` which gives back the
+ * space to memory if this slab has been marked as REUSABLE.
+ * @return 0 if succeed; 1 failed.
+ */
+int slab_deallocate(SlabMetaData *meta, const uintptr_t targetAddr) {
+    struct slab_manager *manager = private__slab_check(meta, targetAddr);
+    if (!manager) return 1;
+
+    lock_acquire(&manager->lock);
+    const int ret = !private__slab_recheck(manager, meta, targetAddr);
+    if (!ret) private__slab_release_cell(manager, meta, targetAddr);
     lock_release(&manager->lock);
-    return 0;
+    return ret;
 }
 
-static void kfree(void *ptr) {
+/**
+ * @brief give the space back to the given heap right away, bypassing the quarantine.
+ * @return 0 if success; 1 if ptr isn't a live allocation of the heap.
+ */
+static int private__heap_free(struct pmm_heap *heap, void *ptr) {
     // different from allocation, as one cpu may allocate a space and then another cpu frees this.
+    struct memory_allocator *allocator = &heap->mem;
     const uintptr_t addr = (uintptr_t) ptr;
-    SlabMetaData *possible_slab_meta = private__slab_get_metaData(addr);
-    int ret = 1;
+    if (!util_in_range(allocator, addr)) return 1;
+
+    const uint8_t registered = __atomic_load_n(util_registry(allocator, addr), __ATOMIC_ACQUIRE);
+    if (addr % PAGE_SIZE == 0 && registered & REGISTRY_PAGE) {
+        // handed out by `pmm_alloc_pages`, such as a pre-zeroed page from `kzalloc`
+        return private__page_free(allocator, addr, registered & ~REGISTRY_PAGE);
+    }
+    SlabMetaData *possible_slab_meta = private__slab_get_metaData(allocator, addr);
     //todo 其实还想要加一个iterator 来保证所有的的类型都检查到。
     if (possible_slab_meta) {
-        // this space is likely within slab
-        ret = slab_deallocate(possible_slab_meta, addr);
+        // this space is within slab, which is nowhere else
+        return slab_deallocate(possible_slab_meta, addr);
+    }
+    return mem_deallocate(allocator, addr);
+}
+
+/**
+ * @brief give the space back to the given heap, through the quarantine in hardened mode.
+ * @return 0 if success; 1 if ptr isn't a live allocation of the heap.
+ */
+static int private__heap_release(struct pmm_heap *heap, void *ptr) {
+#ifdef PMM_HARDENED
+    void *real = ptr;
+    if (private__hardened_free(heap, &real)) return 1;
+    if (real != ptr) {
+        // ptr is held in quarantine, and the oldest one there, if any, is freed for real
+        if (real) private__heap_free(heap, real);
+        return 0;
+    }
+#endif
+    return private__heap_free(heap, ptr);
+}
+
+/**
+ * @brief give the space back to the given heap, which must be where it was allocated.
+ */
+void pmm_heap_free(struct pmm_heap *heap, void *ptr) {
+    private__heap_release(heap, ptr);
+}
+
+#ifdef PMM_HARDENED
+// where hardened mode keeps the requested size of a pointer, see `private__hardened_locate`
+struct redzone_slot {
+    size_t usable;
+    uint8_t *guard; // PMM_REDZONE_GUARD bytes ahead of the first cell, or of header
+    uint8_t *cell; // the requested size plus one of a slab cell; NULL, for a block
+    struct redzone_header *header; // of a block from `mem_allocate`; NULL, for a slab cell
+};
+
+/**
+ * @brief find out where the requested size of ptr is kept. Unlike `pmm_heap_usable_size`,
+ * nothing of ptr is trusted before it's checked against registry and metadata.
+ * @return 0, if ptr has a redzone, and *slot is filled in;
+ * 1, if ptr is out of the heap or a page block, neither of which has a redzone;
+ * -1, if ptr can't have been allocated from the heap.
+ */
+static int private__hardened_locate(struct memory_allocator *allocator, const uintptr_t addr,
+                                    struct redzone_slot *slot) {
+    if (!util_in_range(allocator, addr)) return 1;
+
+    const uint8_t registered = *util_registry(allocator, addr);
+    if (addr % PAGE_SIZE == 0 && registered & REGISTRY_PAGE) return 1;
+    if (registered & REGISTRY_SLAB) {
+        SlabMetaData *meta = private__slab_get_metaData(allocator, addr);
+        const uintptr_t cells = (uintptr_t) meta + meta->offset;
+        if (meta->MAGIC != SLAB_METADATA_MAGIC || addr < cells || (addr - cells) % meta->typeSize) return -1;
+        const size_t num = (addr - cells) / meta->typeSize;
+        if (num >= meta->groups * (sizeof(bitmap) * 8)) return -1;
+        slot->usable = meta->typeSize;
+        slot->guard = (uint8_t *) cells - PMM_REDZONE_GUARD;
+        slot->cell = &meta->requested[num];
+        slot->header = NULL;
+        return 0;
+    }
+    // blocks from `mem_allocate` are aligned to their size, which is at least a page
+    if (addr % PAGE_SIZE) return -1;
+    const size_t offset = *(size_t *) (addr - sizeof(size_t));
+    const uintptr_t metaAddr = (uintptr_t) private__mem_get_metadata(addr - offset);
+    if (offset > addr - allocator->start || !util_in_range(allocator, metaAddr)) return -1;
+    const int order = *util_registry(allocator, metaAddr);
+    if (order < allocator->base_order || order > allocator->max_order
+        || ((MemMetaData *) metaAddr)->MAGIC != MEM_METADATA_MAGIC
+        || addr >= metaAddr + ((uintptr_t) 1 << order)) {
+        return -1;
+    }
+    slot->usable = metaAddr + ((uintptr_t) 1 << order) - addr;
+    slot->header = (struct redzone_header *) (addr - sizeof(size_t) - sizeof(struct redzone_header));
+    slot->guard = (uint8_t *) slot->header - PMM_REDZONE_GUARD;
+    slot->cell = NULL;
+    return 0;
+}
+
+/**
+ * @return the requested size kept in slot; -1, if it's free or the header is broken.
+ */
+static int64_t private__hardened_requested(const struct redzone_slot *slot) {
+    if (slot->cell) {
+        const uint8_t cell = __atomic_load_n(slot->cell, __ATOMIC_ACQUIRE);
+        return cell && cell <= slot->usable + 1 ? cell - 1 : -1;
+    }
+    const uint32_t size = __atomic_load_n(&slot->header->size, __ATOMIC_ACQUIRE);
+    return size && slot->header->check == (size ^ PMM_REDZONE_CHECK) && size <= slot->usable ? (int64_t) size : -1;
+}
+
+/**
+ * @return whether the guard ahead of ptr and the redzone behind its requested size are intact.
+ */
+static int private__hardened_intact(const uintptr_t ptr, const struct redzone_slot *slot, const size_t size) {
+    for (int i = 0; i < PMM_REDZONE_GUARD; ++i) {
+        if (slot->guard[i] != PMM_REDZONE_BYTE) return 0;
+    }
+    for (uintptr_t p = ptr + size; p < ptr + slot->usable; ++p) {
+        if (*(uint8_t *) p != PMM_REDZONE_BYTE) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief record the requested size of ptr and fill the redzone behind it. A block also gets its
+ * guard here, while the guard of a slab is filled once by `slab_request_mem`.
+ */
+static void private__hardened_arm(struct pmm_heap *heap, void *ptr, const size_t size) {
+    struct redzone_slot slot;
+    if (private__hardened_locate(&heap->mem, (uintptr_t) ptr, &slot)) return;
+
+    memset((uint8_t *) ptr + size, PMM_REDZONE_BYTE, slot.usable - size);
+    if (slot.cell) {
+        __atomic_store_n(slot.cell, (uint8_t) (size + 1), __ATOMIC_RELEASE);
+    } else {
+        memset(slot.guard, PMM_REDZONE_BYTE, PMM_REDZONE_GUARD);
+        slot.header->check = (uint32_t) size ^ PMM_REDZONE_CHECK;
+        __atomic_store_n(&slot.header->size, (uint32_t) size, __ATOMIC_RELEASE);
+    }
+    struct pmm_hardened_stats *stats = &heap->managers[cpu_current()].hardened_stats;
+    __atomic_fetch_add(&stats->redzone_bytes, slot.usable - size, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief verify the guard and redzone of ptr, clear its requested size, poison it and put it
+ * in the quarantine of current cpu.
+ * @param p_ptr the pointer to be freed; on return, the pointer that should be freed for real
+ * now, i.e. ptr itself if it has no redzone, or the oldest pointer which has been pushed out of
+ * quarantine; NULL, if there is none.
+ * @return 0 if success; 1 if the guard or redzone is broken, ptr is freed already, or it can't
+ * have been allocated.
+ */
+static int private__hardened_free(struct pmm_heap *heap, void **p_ptr) {
+    void *ptr = *p_ptr;
+    struct memory_allocator *allocator = &heap->mem;
+    struct slab_manager *manager = &heap->managers[cpu_current()];
+    struct pmm_hardened_stats *stats = &manager->hardened_stats;
+    struct redzone_slot slot;
+    const int located = private__hardened_locate(allocator, (uintptr_t) ptr, &slot);
+    if (located > 0) return 0;
+
+    int64_t size = located < 0 ? -1 : private__hardened_requested(&slot);
+    // cleared at once, so that of two frees racing for ptr, only one goes on
+    if (size >= 0 && !(slot.cell ? __atomic_exchange_n(slot.cell, 0, __ATOMIC_ACQ_REL)
+                                  : __atomic_exchange_n(&slot.header->size, 0, __ATOMIC_ACQ_REL))) {
+        size = -1;
+    }
+    if (size < 0 || !private__hardened_intact((uintptr_t) ptr, &slot, size)) {
+        // freed twice, invalid, or overflowed. Never reuse it.
+        __atomic_fetch_add(&stats->violations, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    memset(ptr, PMM_POISON_BYTE, slot.usable);
+    __atomic_fetch_add(&stats->poisoned_bytes, slot.usable, __ATOMIC_RELAXED);
+
+    void *evicted = NULL;
+    lock_acquire(&manager->quarantine_lock);
+    if (manager->quarantine_count == PMM_QUARANTINE) {
+        evicted = manager->quarantine[manager->quarantine_head];
+        manager->quarantine[manager->quarantine_head] = ptr;
+        manager->quarantine_head = (manager->quarantine_head + 1) % PMM_QUARANTINE;
+    } else {
+        manager->quarantine[(manager->quarantine_head + manager->quarantine_count) % PMM_QUARANTINE] = ptr;
+        manager->quarantine_count++;
+    }
+    lock_release(&manager->quarantine_lock);
+
+    __atomic_fetch_add(&stats->quarantined, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->quarantine_bytes, (int64_t) slot.usable, __ATOMIC_RELAXED);
+    if (evicted && !private__hardened_locate(allocator, (uintptr_t) evicted, &slot)) {
+        __atomic_fetch_sub(&stats->quarantine_bytes, (int64_t) slot.usable, __ATOMIC_RELAXED);
+    }
+    *p_ptr = evicted;
+    return 0;
+}
+
+/**
+ * @brief free every pointer held in quarantine of every cpu, used by `pmm_heap_reclaim`.
+ * @return how many pages have been given back, approximately.
+ */
+static size_t private__hardened_flush(struct pmm_heap *heap) {
+    size_t bytes = 0;
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        struct slab_manager *manager = &heap->managers[cpu];
+        void *ptr;
+        do {
+            ptr = NULL;
+            lock_acquire(&manager->quarantine_lock);
+            if (manager->quarantine_count > 0) {
+                ptr = manager->quarantine[manager->quarantine_head];
+                manager->quarantine_head = (manager->quarantine_head + 1) % PMM_QUARANTINE;
+                manager->quarantine_count--;
+            }
+            lock_release(&manager->quarantine_lock);
+            struct redzone_slot slot;
+            if (ptr && !private__hardened_locate(&heap->mem, (uintptr_t) ptr, &slot)) {
+                __atomic_fetch_sub(&manager->hardened_stats.quarantine_bytes, (int64_t) slot.usable, __ATOMIC_RELAXED);
+                bytes += slot.usable;
+            }
+            if (ptr) private__heap_free(heap, ptr);
+        } while (ptr);
+    }
+    return bytes / PAGE_SIZE;
+}
+
+/**
+ * @brief verify the guard of a slab and the redzone of every cell in use, for `pmm_heap_check`.
+ * A cell with a requested size must be allocated, though a cell in quarantine has none.
+ * @return 0, if they are intact; else, 1.
+ */
+static int private__hardened_check_slab(SlabMetaData *meta) {
+    const uintptr_t cells = (uintptr_t) meta + meta->offset;
+    const int capacity = (int) (meta->groups * (sizeof(bitmap) * 8));
+    for (int i = 0; i < capacity; ++i) {
+        struct redzone_slot slot = {
+            .usable = meta->typeSize, .guard = (uint8_t *) cells - PMM_REDZONE_GUARD, .cell = &meta->requested[i],
+        };
+        // the guard alone, for a free cell
+        const int64_t size = meta->requested[i] ? private__hardened_requested(&slot) : meta->typeSize;
+        if (size < 0 || !private__hardened_intact(cells + i * meta->typeSize, &slot, size)) return 1;
+#ifdef NDEBUG
+        // bitmaps aren't maintained in freelist mode
+        if (meta->freelist) continue;
+#endif
+        const bitmap b = meta->p_bitmap[i / (sizeof(bitmap) * 8)];
+        if (meta->requested[i] && !util_bitmap_test(b, i % (sizeof(bitmap) * 8))) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief verify the guard, header and redzone of a block from `mem_allocate` at addr, for
+ * `pmm_heap_check`. `mem_allocate` always takes twice the rounded size, so that the space begins
+ * in the middle of the block.
+ * @return 0, if they are intact; else, 1.
+ */
+static int private__hardened_check_block(struct memory_allocator *allocator, const uintptr_t addr, const int order) {
+    const uintptr_t beginning = addr + ((uintptr_t) 1 << (order - 1));
+    if (((MemMetaData *) addr)->MAGIC != MEM_METADATA_MAGIC
+        || *(size_t *) (beginning - sizeof(size_t)) != beginning - private__mem_get_space_with_metaAddr(addr)) {
+        return 1;
+    }
+    struct redzone_slot slot;
+    if (private__hardened_locate(allocator, beginning, &slot)) return 1;
+    // a block in quarantine has its size cleared, and the guard is all that's left to verify
+    const int64_t size = slot.header->size ? private__hardened_requested(&slot) : (int64_t) slot.usable;
+    return size < 0 || !private__hardened_intact(beginning, &slot, size);
+}
+
+/**
+ * @brief sum up the overhead counters of hardened mode over all cpus.
+ * @note counters are read without locks, so the sum is approximate.
+ */
+void pmm_heap_hardened_stats(struct pmm_heap *heap, struct pmm_hardened_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        const struct pmm_hardened_stats *p = &heap->managers[cpu].hardened_stats;
+        stats->redzone_bytes += __atomic_load_n(&p->redzone_bytes, __ATOMIC_RELAXED);
+        stats->poisoned_bytes += __atomic_load_n(&p->poisoned_bytes, __ATOMIC_RELAXED);
+        stats->quarantined += __atomic_load_n(&p->quarantined, __ATOMIC_RELAXED);
+        stats->quarantine_bytes += __atomic_load_n(&p->quarantine_bytes, __ATOMIC_RELAXED);
+        stats->violations += __atomic_load_n(&p->violations, __ATOMIC_RELAXED);
     }
-    if (ret) {
-        mem_deallocate(addr);
+}
+
+void pmm_hardened_stats(struct pmm_hardened_stats *stats) {
+    pmm_heap_hardened_stats(DefaultHeap, stats);
+}
+#endif
+
+static void kfree(void *ptr) {
+#ifdef PMM_LATENCY
+    const uint64_t begin = PMM_CLOCK();
+    pmm_heap_free(DefaultHeap, ptr);
+    private__latency_record(PMM_OP_FREE, PMM_CLOCK() - begin);
+#else
+    pmm_heap_free(DefaultHeap, ptr);
+#endif
+}
+
+#ifdef PMM_LATENCY
+/**
+ * @brief merge histograms of all cpus into buckets, see LATENCY_BUCKETS for what each one counts.
+ * @note histograms are read without locks, so the result is approximate if other cpus are
+ * still allocating.
+ * @return the number of operations in all buckets.
+ */
+uint64_t pmm_latency_histogram(const enum pmm_op op, uint64_t buckets[LATENCY_BUCKETS]) {
+    uint64_t total = 0;
+    memset(buckets, 0, LATENCY_BUCKETS * sizeof(uint64_t));
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+            buckets[i] += DefaultHeap->managers[cpu].latency[op][i];
+            total += DefaultHeap->managers[cpu].latency[op][i];
+        }
     }
+    return total;
+}
+
+/**
+ * @brief merge histograms of all cpus and find the given percentile, e.g. 990 for p99 and
+ * 999 for p99.9.
+ * @return the upper bound of the bucket where the percentile falls, in ticks of PMM_CLOCK;
+ * 0, if nothing has been recorded.
+ */
+uint64_t pmm_latency_percentile(const enum pmm_op op, const int permille) {
+    uint64_t merged[LATENCY_BUCKETS];
+    const uint64_t total = pmm_latency_histogram(op, merged);
+    if (total == 0) return 0;
+
+    const uint64_t rank = (total * permille + 999) / 1000; // ceiling
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += merged[i];
+        if (seen >= rank) return (uint64_t) 1 << (i + 1);
+    }
+    return (uint64_t) 1 << LATENCY_BUCKETS;
+}
+
+/**
+ * @brief clear the histograms of all cpus, e.g. between two phases of a benchmark.
+ */
+void pmm_latency_reset() {
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        memset(DefaultHeap->managers[cpu].latency, 0, sizeof(DefaultHeap->managers[cpu].latency));
+    }
+}
+#endif
+
+/**
+ * @brief how many bytes can actually be used at ptr, which must have been allocated from the
+ * given heap and not freed yet. It's answered by metadata in O(1):
+ * - a page block: its whole size, by registry;
+ * - a slab cell: typeSize of the slab;
+ * - a block from `mem_allocate`: the order in registry minus the offset ahead of ptr.
+ * @return the usable size; 0, if ptr is out of the heap.
+ */
+size_t pmm_heap_usable_size(struct pmm_heap *heap, void *ptr) {
+#ifdef PMM_HARDENED
+    // only the requested size is usable, the rest is redzone
+    struct redzone_slot slot;
+    if (!private__hardened_locate(&heap->mem, (uintptr_t) ptr, &slot)) {
+        const int64_t size = private__hardened_requested(&slot);
+        return size < 0 ? 0 : (size_t) size;
+    }
+#endif
+    struct memory_allocator *allocator = &heap->mem;
+    const uintptr_t addr = (uintptr_t) ptr;
+    if (!util_in_range(allocator, addr)) return 0;
+
+    const uint8_t registered = *util_registry(allocator, addr);
+    if (addr % PAGE_SIZE == 0 && registered & REGISTRY_PAGE) {
+        return (size_t) 1 << (registered & ~REGISTRY_PAGE);
+    }
+    if (registered & REGISTRY_SLAB) {
+        return private__slab_get_metaData(allocator, addr)->typeSize;
+    }
+    const uintptr_t space = addr - *(size_t *) (addr - sizeof(size_t));
+    const uintptr_t metaAddr = (uintptr_t) private__mem_get_metadata(space);
+    return ((size_t) 1 << *util_registry(allocator, metaAddr)) - (addr - metaAddr);
+}
+
+size_t kalloc_usable_size(void *ptr) {
+    return pmm_heap_usable_size(DefaultHeap, ptr);
+}
+
+/**
+ * @brief free a pointer allocated with PMM_TAG(tag), so that it's taken off that tag. A free
+ * which is rejected, e.g. a double free, isn't taken off.
+ */
+void pmm_heap_free_tagged(struct pmm_heap *heap, void *ptr, const int tag) {
+    if (!ptr) return;
+    const size_t size = pmm_heap_usable_size(heap, ptr);
+    if (private__heap_release(heap, ptr)) return;
+    if (tag > 0 && tag < PMM_TAGS) {
+        struct pmm_tag_stats *stats = &heap->managers[cpu_current()].tag_stats[tag];
+        __atomic_fetch_add(&stats->frees, 1, __ATOMIC_RELAXED);
+        private__tag_account(heap, tag, -(int64_t) size);
+    }
+}
+
+void kfree_tagged(void *ptr, const int tag) {
+    pmm_heap_free_tagged(DefaultHeap, ptr, tag);
+}
+
+/**
+ * @brief set the soft quota of live bytes of the given tag, 0 means unlimited.
+ */
+void pmm_heap_set_tag_quota(struct pmm_heap *heap, const int tag, const size_t bytes) {
+    if (tag <= 0 || tag >= PMM_TAGS) return;
+    __atomic_store_n(&heap->tag_quota[tag], bytes, __ATOMIC_RELAXED);
+}
+
+void pmm_set_tag_quota(const int tag, const size_t bytes) {
+    pmm_heap_set_tag_quota(DefaultHeap, tag, bytes);
+}
+
+/**
+ * @brief sum up the counters of the given tag over all cpus.
+ * @note counters are read without locks, so the sum is approximate if other cpus are still
+ * allocating. The allocation rate is the difference of `allocs` between two calls.
+ */
+void pmm_heap_tag_stats(struct pmm_heap *heap, const int tag, struct pmm_tag_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (tag <= 0 || tag >= PMM_TAGS) return;
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        const struct pmm_tag_stats *p = &heap->managers[cpu].tag_stats[tag];
+        stats->live_bytes += __atomic_load_n(&p->live_bytes, __ATOMIC_RELAXED);
+        stats->allocs += __atomic_load_n(&p->allocs, __ATOMIC_RELAXED);
+        stats->frees += __atomic_load_n(&p->frees, __ATOMIC_RELAXED);
+        stats->refused += __atomic_load_n(&p->refused, __ATOMIC_RELAXED);
+    }
+}
+
+void pmm_tag_stats(const int tag, struct pmm_tag_stats *stats) {
+    pmm_heap_tag_stats(DefaultHeap, tag, stats);
+}
+
+/**
+ * @brief queue the pointer on current cpu, instead of freeing it right away.
+ *
+ * It's freed by `pmm_drain_deferred` once its grace period has elapsed, which is tried as soon
+ * as DEFERRED_THRESHOLD pointers are queued. If DEFERRED_CAPACITY are, it waits for a grace
+ * period to elapse, see the contract in common.h.
+ */
+void kfree_deferred(void *ptr) {
+    struct pmm_heap *heap = DefaultHeap;
+    struct slab_manager *manager = &heap->managers[cpu_current()];
+    // there is nothing to wait for, as kfree would ignore it anyway
+    if (!ptr || !util_in_range(&heap->mem, (uintptr_t) ptr)) return;
+    for (;;) {
+        lock_acquire(&manager->deferred_lock);
+        const int n = manager->deferred_count;
+        if (n < DEFERRED_CAPACITY) {
+            manager->deferred[n].ptr = ptr;
+            manager->deferred[n].epoch = __atomic_load_n(&heap->epoch, __ATOMIC_SEQ_CST);
+            manager->deferred_count = n + 1;
+        }
+        lock_release(&manager->deferred_lock);
+        if (n < DEFERRED_CAPACITY) {
+            if (n + 1 >= DEFERRED_THRESHOLD) pmm_drain_deferred();
+            return;
+        }
+        // full, current cpu is outside any read-side section by contract
+        pmm_quiescent();
+        if (manager->deferred_count == DEFERRED_CAPACITY) yield();
+    }
+}
+
+/**
+ * @return the oldest epoch that every cpu has passed a quiescent state in.
+ */
+static uint64_t private__quiescent_min(struct pmm_heap *heap) {
+    uint64_t min = UINT64_MAX;
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        const uint64_t epoch = __atomic_load_n(&heap->managers[cpu].quiescent_epoch, __ATOMIC_SEQ_CST);
+        if (epoch < min) min = epoch;
+    }
+    return min;
+}
+
+/**
+ * @brief report that current cpu is in a quiescent state, and free what it has queued whose
+ * grace period has elapsed.
+ *
+ * Once every cpu has passed a quiescent state in the current epoch, the epoch advances. A
+ * pointer queued in epoch e has outlived every reader once each cpu has passed one in a later
+ * epoch, since that epoch began after the pointer was queued. With a single cpu, that's at
+ * the next call.
+ */
+void pmm_quiescent() {
+    struct pmm_heap *heap = DefaultHeap;
+    struct slab_manager *self = &heap->managers[cpu_current()];
+    uint64_t epoch = __atomic_load_n(&heap->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&self->quiescent_epoch, epoch, __ATOMIC_SEQ_CST);
+    if (private__quiescent_min(heap) == epoch &&
+        __atomic_compare_exchange_n(&heap->epoch, &epoch, epoch + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        // still quiescent, so it has passed the new epoch as well
+        __atomic_store_n(&self->quiescent_epoch, epoch + 1, __ATOMIC_SEQ_CST);
+    }
+    pmm_drain_deferred();
+}
+
+/**
+ * @brief free the pointers queued on current cpu whose grace period has elapsed, in batches of
+ * DEFERRED_THRESHOLD at most.
+ *
+ * Pointers are grouped by the slab manager that owns them, and those handed out by
+ * MemAllocator form one more group. Each group then takes its lock only once. Everything is
+ * validated again under that lock, so a pointer queued twice is only freed once.
+ */
+void pmm_drain_deferred() {
+    struct memory_allocator *allocator = &DefaultHeap->mem;
+    struct slab_manager *self = &DefaultHeap->managers[cpu_current()];
+    void *ptrs[DEFERRED_THRESHOLD];
+    struct slab_manager *owners[DEFERRED_THRESHOLD]; // NULL stands for MemAllocator
+    // pointers queued before this epoch have expired
+    const uint64_t expired = private__quiescent_min(DefaultHeap);
+    int n;
+    do {
+        lock_acquire(&self->deferred_lock);
+        n = 0;
+        while (n < DEFERRED_THRESHOLD && n < self->deferred_count && self->deferred[n].epoch < expired) {
+            ptrs[n] = self->deferred[n].ptr;
+            n++;
+        }
+        // the rest keep waiting in order
+        self->deferred_count -= n;
+        memmove(self->deferred, self->deferred + n, self->deferred_count * sizeof(struct deferred_entry));
+        lock_release(&self->deferred_lock);
+
+#ifdef PMM_HARDENED
+        // each one is verified and goes through quarantine, just like `kfree`, rather than in groups
+        for (int i = 0; i < n; ++i) {
+            private__heap_release(DefaultHeap, ptrs[i]);
+        }
+        continue;
+#endif
+        // classify and insertion sort by owner, the first m are kept
+        int m = 0;
+        for (int i = 0; i < n; ++i) {
+            void *ptr = ptrs[i];
+            struct slab_manager *owner = NULL;
+            const uintptr_t addr = (uintptr_t) ptr;
+            if (!util_in_range(allocator, addr)) continue;
+
+            const uint8_t registered = __atomic_load_n(util_registry(allocator, addr), __ATOMIC_ACQUIRE);
+            if (registered & REGISTRY_SLAB) {
+                owner = private__slab_check(private__slab_get_metaData(allocator, addr), addr);
+                // a cell goes back to its slab, or nowhere
+                if (!owner) continue;
+            }
+            int j = m++;
+            for (; j > 0 && (uintptr_t) owners[j - 1] > (uintptr_t) owner; --j) {
+                ptrs[j] = ptrs[j - 1];
+                owners[j] = owners[j - 1];
+            }
+            ptrs[j] = ptr;
+            owners[j] = owner;
+        }
+
+        int i = 0;
+        while (i < m && !owners[i]) i++;
+        if (i > 0) {
+            // pages and blocks from `mem_allocate`
+            lock_acquire(&allocator->lock);
+            for (int k = 0; k < i; ++k) {
+                const uintptr_t addr = (uintptr_t) ptrs[k];
+                const uint8_t registered = *util_registry(allocator, addr);
+                if (addr % PAGE_SIZE == 0 && registered & REGISTRY_PAGE) {
+                    private__pmm_free_pages(allocator, addr, registered & ~REGISTRY_PAGE);
+                } else {
+                    private__mem_deallocate(allocator, addr - *(size_t *) (addr - sizeof(size_t)));
+                }
+            }
+            lock_release(&allocator->lock);
+        }
+        while (i < m) {
+            struct slab_manager *manager = owners[i];
+            lock_acquire(&manager->lock);
+            for (; i < m && owners[i] == manager; ++i) {
+                const uintptr_t addr = (uintptr_t) ptrs[i];
+                SlabMetaData *meta = private__slab_get_metaData(allocator, addr);
+                if (private__slab_recheck(manager, meta, addr)) private__slab_release_cell(manager, meta, addr);
+            }
+            lock_release(&manager->lock);
+        }
+    } while (n == DEFERRED_THRESHOLD);
+}
+
+/**
+ * @brief switch the placement policy of the given heap, free lists are re-sorted if needed.
+ * @note it's cheap right after `pmm_heap_create`, while free lists are still short.
+ */
+void pmm_heap_set_placement(struct pmm_heap *heap, const enum placement placement) {
+    struct memory_allocator *allocator = &heap->mem;
+    lock_acquire(&allocator->lock);
+    allocator->placement = placement;
+    if (placement == PLACEMENT_ADDRESS) {
+        for (size_t i = 0; i < LENGTH(allocator->free_list); ++i) {
+            MemMetaData *p = allocator->free_list[i];
+            allocator->free_list[i] = allocator->free_tail[i] = NULL;
+            __atomic_store_n(&allocator->free_pages, allocator->free_pages - ((size_t) allocator->free_count[i] << i),
+                             __ATOMIC_RELAXED);
+            allocator->free_count[i] = 0;
+            while (p) {
+                MemMetaData *next = p->next;
+                util_list_add(allocator, i, p, 0);
+                p = next;
+            }
+        }
+    }
+    lock_release(&allocator->lock);
+}
+
+void pmm_set_placement(const enum placement placement) {
+    pmm_heap_set_placement(DefaultHeap, placement);
+}
+
+/**
+ * @brief set the watermarks of the given heap, in pages. 0 disables either of them.
+ * @see memory_allocator.watermark_low
+ */
+void pmm_heap_set_watermarks(struct pmm_heap *heap, const size_t min_pages, const size_t low_pages) {
+    lock_acquire(&heap->mem.lock);
+    __atomic_store_n(&heap->mem.watermark_min, min_pages, __ATOMIC_RELAXED);
+    __atomic_store_n(&heap->mem.watermark_low, low_pages, __ATOMIC_RELAXED);
+    lock_release(&heap->mem.lock);
+}
+
+void pmm_set_watermarks(const size_t min_pages, const size_t low_pages) {
+    pmm_heap_set_watermarks(DefaultHeap, min_pages, low_pages);
+}
+
+/**
+ * @brief register a reclaimer which is run by `pmm_heap_reclaim`.
+ * @return 0, if succeed; 1, if there are RECLAIMERS of them already.
+ */
+int pmm_heap_register_reclaim(struct pmm_heap *heap, const pmm_reclaim_fn fn, void *arg) {
+    int ret = 1;
+    lock_acquire(&heap->reclaim_lock);
+    if (heap->reclaimer_count < RECLAIMERS) {
+        heap->reclaimers[heap->reclaimer_count].fn = fn;
+        heap->reclaimers[heap->reclaimer_count].arg = arg;
+        heap->reclaimer_count++;
+        ret = 0;
+    }
+    lock_release(&heap->reclaim_lock);
+    return ret;
+}
+
+int pmm_register_reclaim(const pmm_reclaim_fn fn, void *arg) {
+    return pmm_heap_register_reclaim(DefaultHeap, fn, arg);
+}
+
+/**
+ * @brief give cached memory back to the given heap.
+ *
+ * Caches of the allocator itself go first: blocks in fast lists and pre-zeroed pages of every
+ * cpu. Registered reclaimers are then run in order of registration, without any lock held, so
+ * several cpus may be running the same reclaimer at once. In hardened mode, quarantines of every
+ * cpu are emptied at the end.
+ * @return how many pages have been given back, approximately.
+ */
+size_t pmm_heap_reclaim(struct pmm_heap *heap) {
+    struct memory_allocator *allocator = &heap->mem;
+    size_t pages = 0;
+
+    lock_acquire(&allocator->lock);
+    const size_t before = allocator->free_pages;
+    private__fast_list_flush(allocator);
+    pages += allocator->free_pages - before;
+    lock_release(&allocator->lock);
+
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        struct slab_manager *manager = &heap->managers[cpu];
+        void *zeroed[ZERO_POOL_CAPACITY];
+        lock_acquire(&manager->lock);
+        const int n = manager->zeroed_count;
+        for (int i = 0; i < n; ++i) {
+            zeroed[i] = manager->zeroed_pages[i];
+        }
+        manager->zeroed_count = 0;
+        lock_release(&manager->lock);
+        for (int i = 0; i < n; ++i) {
+            pmm_heap_free(heap, zeroed[i]);
+        }
+        pages += n;
+    }
+
+    struct pmm_reclaimer reclaimers[RECLAIMERS];
+    lock_acquire(&heap->reclaim_lock);
+    const int n = heap->reclaimer_count;
+    for (int i = 0; i < n; ++i) {
+        reclaimers[i] = heap->reclaimers[i];
+    }
+    lock_release(&heap->reclaim_lock);
+    for (int i = 0; i < n; ++i) {
+        pages += reclaimers[i].fn(heap, reclaimers[i].arg);
+    }
+#ifdef PMM_HARDENED
+    // last, since what reclaimers have just freed is held in quarantine as well
+    pages += private__hardened_flush(heap);
+#endif
+    return pages;
+}
+
+/**
+ * @brief set the lazy buddy threshold of the given order, 0 disables it.
+ *
+ * Blocks of that order which are freed while its free list has fewer than `threshold` blocks
+ * stay uncoalesced. This saves splitting them straight back if blocks of the same size are
+ * allocated and freed over and over. They are merged only when an allocation can't be served.
+ */
+void pmm_heap_set_lazy_threshold(struct pmm_heap *heap, const int order, const int threshold) {
+    struct memory_allocator *allocator = &heap->mem;
+    if (order < allocator->base_order || order > allocator->max_order) return;
+
+    lock_acquire(&allocator->lock);
+    allocator->lazy_threshold[order - allocator->base_order] = threshold;
+    lock_release(&allocator->lock);
+}
+
+void pmm_set_lazy_threshold(const int order, const int threshold) {
+    pmm_heap_set_lazy_threshold(DefaultHeap, order, threshold);
+}
+
+/**
+ * @brief take a fragmentation sample of the given heap.
+ *
+ * Each free list and each slab manager is walked under its own lock, one at a time, so the
+ * sample isn't atomic as a whole, which is fine for observing trends.
+ */
+void pmm_heap_sample(struct pmm_heap *heap, struct pmm_sample *sample) {
+    struct memory_allocator *allocator = &heap->mem;
+    memset(sample, 0, sizeof(*sample));
+    sample->largest_order = -1;
+
+    lock_acquire(&allocator->lock);
+    for (int i = 0; i <= allocator->max_order - allocator->base_order; ++i) {
+        for (MemMetaData *p = allocator->free_list[i]; p; p = p->next) {
+            sample->free_blocks[i]++;
+        }
+        if (sample->free_blocks[i]) sample->largest_order = i + allocator->base_order;
+    }
+    lock_release(&allocator->lock);
+    for (int i = 0; i < FAST_ORDERS; ++i) {
+        sample->fast_blocks[i] = __atomic_load_n(&allocator->fast_list[i].count, __ATOMIC_RELAXED);
+        if (sample->fast_blocks[i] && sample->largest_order < i + allocator->base_order) {
+            sample->largest_order = i + allocator->base_order;
+        }
+    }
+
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        struct slab_manager *manager = &heap->managers[cpu];
+        lock_acquire(&manager->lock);
+        for (int i = 0; i < SLAB_TYPES * LIFETIMES; ++i) {
+            SlabMetaData *sentinel = &manager->sentinels[i / SLAB_TYPES][i % SLAB_TYPES];
+            for (SlabMetaData *p = sentinel->next; p != sentinel; p = p->next) {
+                const int capacity = (int) (p->groups * (sizeof(bitmap) * 8));
+                sample->slabs[i % SLAB_TYPES]++;
+                sample->cells[i % SLAB_TYPES] += capacity;
+                sample->used_cells[i % SLAB_TYPES] += capacity - p->remaining;
+            }
+        }
+        lock_release(&manager->lock);
+    }
+}
+
+void pmm_sample(struct pmm_sample *sample) {
+    pmm_heap_sample(DefaultHeap, sample);
+}
+
+/**
+ * where `pmm_heap_snapshot` writes to, it keeps counting after the buffer is full.
+ */
+struct snapshot_cursor {
+    uint8_t *buf;
+    size_t len, pos;
+};
+
+static void private__snapshot_put(struct snapshot_cursor *cursor, const void *data, const size_t size) {
+    if (cursor->pos + size <= cursor->len) {
+        memcpy(cursor->buf + cursor->pos, data, size);
+    }
+    cursor->pos += size;
+}
+
+static void private__snapshot_put_u32(struct snapshot_cursor *cursor, const uint32_t value) {
+    private__snapshot_put(cursor, &value, sizeof(value));
+}
+
+/**
+ * @brief serialize the whole state of the given heap into buf, in the format described in
+ * "common.h". Nothing is written beyond len bytes.
+ *
+ * Every slab manager and then the memory allocator are locked for the duration, in the same
+ * order as allocation takes them, so the snapshot is consistent. Fast lists are lock-free, so
+ * they are walked as they are, without being flushed, see `util_tagged_walk`; their section is
+ * exact only if no other cpu allocates or frees pages meanwhile.
+ * @note bitmaps of freelist mode are only meaningful unless NDEBUG is defined.
+ * @return the size of the whole snapshot, which is larger than len if buf is too small,
+ * similar to snprintf.
+ */
+size_t pmm_heap_snapshot(struct pmm_heap *heap, void *buf, const size_t len) {
+    struct memory_allocator *allocator = &heap->mem;
+    struct snapshot_cursor cursor = {(uint8_t *) buf, len, 0};
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        lock_acquire(&heap->managers[cpu].lock);
+    }
+    lock_acquire(&allocator->lock);
+
+    const struct pmm_snapshot_header header = {
+            .magic = PMM_SNAPSHOT_MAGIC,
+            .version = PMM_SNAPSHOT_VERSION,
+            .base_order = allocator->base_order,
+            .max_order = allocator->max_order,
+            .start = allocator->start,
+            .end = allocator->end,
+            .pages = (allocator->end - allocator->start) >> allocator->base_order,
+            .cpus = cpu_count(),
+            .slab_types = SLAB_TYPES,
+            .lifetimes = LIFETIMES,
+            .fast_orders = FAST_ORDERS,
+    };
+    private__snapshot_put(&cursor, &header, sizeof(header));
+
+    for (int i = 0; i <= allocator->max_order - allocator->base_order; ++i) {
+        private__snapshot_put_u32(&cursor, allocator->free_count[i]);
+        for (MemMetaData *p = allocator->free_list[i]; p; p = p->next) {
+            const uint64_t address = (uintptr_t) p - allocator->start;
+            private__snapshot_put(&cursor, &address, sizeof(address));
+        }
+    }
+    for (int i = 0; i < FAST_ORDERS; ++i) {
+        // count may run past the limit for a while, as it's checked before pushing
+        uintptr_t cached[2 * FAST_LIST_LIMIT];
+        const int n = util_tagged_walk(allocator, &allocator->fast_list[i], i + allocator->base_order,
+                                       cached, LENGTH(cached));
+        private__snapshot_put_u32(&cursor, n);
+        for (int j = 0; j < n; ++j) {
+            const uint64_t address = cached[j] - allocator->start;
+            private__snapshot_put(&cursor, &address, sizeof(address));
+        }
+    }
+    private__snapshot_put(&cursor, allocator->registry, header.pages);
+
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        struct slab_manager *manager = &heap->managers[cpu];
+        for (int i = 0; i < SLAB_TYPES; ++i) {
+            private__snapshot_put_u32(&cursor, manager->populated[i]);
+        }
+        private__snapshot_put_u32(&cursor, manager->zeroed_count);
+        private__snapshot_put_u32(&cursor, manager->deferred_count);
+        for (int i = 0; i < SLAB_TYPES * LIFETIMES; ++i) {
+            SlabMetaData *sentinel = &manager->sentinels[i / SLAB_TYPES][i % SLAB_TYPES];
+            uint32_t slabs = 0;
+            for (SlabMetaData *p = sentinel->next; p != sentinel; p = p->next) slabs++;
+            private__snapshot_put_u32(&cursor, sentinel->grow_pages);
+            private__snapshot_put_u32(&cursor, slabs);
+            for (SlabMetaData *p = sentinel->next; p != sentinel; p = p->next) {
+                const struct pmm_snapshot_slab slab = {
+                        .address = (uintptr_t) p - allocator->start,
+                        .status = p->status,
+                        .type_size = p->typeSize,
+                        .groups = p->groups,
+                        .remaining = p->remaining,
+                        .offset = p->offset,
+                        .color = p->color,
+                };
+                private__snapshot_put(&cursor, &slab, sizeof(slab));
+                private__snapshot_put(&cursor, p->p_bitmap, p->groups * sizeof(bitmap));
+            }
+        }
+    }
+
+    lock_release(&allocator->lock);
+    for (int cpu = cpu_count() - 1; cpu >= 0; --cpu) {
+        lock_release(&heap->managers[cpu].lock);
+    }
+    return cursor.pos;
+}
+
+size_t pmm_snapshot(void *buf, const size_t len) {
+    return pmm_heap_snapshot(DefaultHeap, buf, len);
+}
+
+// marks pages of free blocks in registry while `pmm_heap_check` runs, never a valid entry.
+#define REGISTRY_CHECKING 0xff
+
+/**
+ * @brief check that the slab is consistent with itself and registry.
+ * @pre the lock of its manager is held.
+ * @return 0, if it is; else, 1.
+ */
+static int private__slab_check_consistency(struct memory_allocator *allocator, SlabMetaData *meta) {
+    if (meta->MAGIC != SLAB_METADATA_MAGIC || private__slab_get_metaData(allocator, (uintptr_t) meta) != meta) return 1;
+
+    const int capacity = (int) (meta->groups * (sizeof(bitmap) * 8));
+    if (meta->remaining < 0 || meta->remaining > capacity) return 1;
+#ifdef NDEBUG
+    // bitmaps aren't maintained in freelist mode
+    if (!meta->freelist) {
+#else
+    {
+#endif
+        int used = 0;
+        for (int g = 0; g < meta->groups; ++g) {
+            used += __builtin_popcount((uint16_t) meta->p_bitmap[g]);
+        }
+        if (used != capacity - meta->remaining) return 1;
+    }
+    if (meta->freelist) {
+        const uintptr_t cells = (uintptr_t) meta + meta->offset;
+        int n = 0;
+        for (void **cell = meta->free_cell; cell; cell = *cell) {
+            // bounded, so that a cycle doesn't hang the check
+            if (++n > meta->remaining) return 1;
+            if ((uintptr_t) cell < cells || (uintptr_t) cell >= cells + capacity * meta->typeSize
+                || ((uintptr_t) cell - cells) % meta->typeSize) {
+                return 1;
+            }
+#ifndef NDEBUG
+            // a free cell whose bit is set is handed out as well
+            const int num = (int) (((uintptr_t) cell - cells) / meta->typeSize);
+            if (util_bitmap_test(meta->p_bitmap[num / (sizeof(bitmap) * 8)], num % (sizeof(bitmap) * 8))) return 1;
+#endif
+        }
+        if (n != meta->remaining) return 1;
+    }
+#ifdef PMM_HARDENED
+    if (private__hardened_check_slab(meta)) return 1;
+#endif
+    return 0;
+}
+
+/**
+ * @brief walk registry from start to end, once pages of free blocks are marked, and check that
+ * it is partitioned into naturally aligned blocks: each page is a free one, the first page of a
+ * block handed out by MemAllocator followed by unregistered pages, or a page of a slab whose
+ * pages all carry the same entry.
+ * @pre the lock of MemAllocator is held, and fast lists are flushed.
+ * @return the number of slabs, if registry is a partition; else, -1.
+ */
+static int private__registry_check(struct memory_allocator *allocator) {
+    int slabs = 0;
+    uintptr_t addr = allocator->start;
+    while (addr < allocator->end) {
+        const uint8_t registered = *util_registry(allocator, addr);
+        if (registered == REGISTRY_CHECKING) {
+            addr += PAGE_SIZE;
+            continue;
+        }
+        const int order = registered & ~(REGISTRY_PAGE | REGISTRY_SLAB);
+        const uintptr_t end = addr + ((uintptr_t) 1 << order);
+        // an unregistered page out of any block belongs to nobody, i.e. it's leaked
+        if (!registered || order < allocator->base_order || order > allocator->max_order
+            || addr % ((uintptr_t) 1 << order) || end > allocator->end) {
+            return -1;
+        }
+        if (registered & REGISTRY_SLAB) {
+            if (registered & REGISTRY_PAGE || ((SlabMetaData *) addr)->MAGIC != SLAB_METADATA_MAGIC) return -1;
+            slabs++;
+        }
+#ifdef PMM_HARDENED
+        if (!(registered & (REGISTRY_PAGE | REGISTRY_SLAB)) && private__hardened_check_block(allocator, addr, order)) {
+            return -1;
+        }
+#endif
+        for (uintptr_t page = addr + PAGE_SIZE; page < end; page += PAGE_SIZE) {
+            // pages of a block are either all marked as a slab, or unregistered after its first one
+            if (*util_registry(allocator, page) != (registered & REGISTRY_SLAB ? registered : 0)) return -1;
+        }
+        addr = end;
+    }
+    return slabs;
+}
+
+/**
+ * @brief check the invariants of the given heap, meant to be called by stress tests, e.g. after
+ * every round of random allocations and frees. It stops the world just like `pmm_heap_snapshot`.
+ *
+ * For MemAllocator, every free block must be in range, aligned to its order, unregistered and
+ * marked by MEM_METADATA_MAGIC, and no page may belong to more than one free block or to any
+ * slab; the lengths of free lists and free_pages must add up. Registry as a whole must be a
+ * partition, see `private__registry_check`, so that each page belongs to exactly one block. For
+ * every slab, its registry and MAGIC must agree, it must be on the list of its manager, and
+ * bitmaps, freelist and remaining must count the same free cells.
+ * Overlapping allocations, i.e. a space handed out twice, break at least one of them.
+ * @return 0, if the heap is consistent; else, 1.
+ */
+int pmm_heap_check(struct pmm_heap *heap) {
+    struct memory_allocator *allocator = &heap->mem;
+    int ret = 0;
+    for (int cpu = 0; cpu < cpu_count(); ++cpu) {
+        lock_acquire(&heap->managers[cpu].lock);
+    }
+    lock_acquire(&allocator->lock);
+    private__fast_list_flush(allocator);
+
+    size_t free_pages = 0;
+    for (int i = 0; i <= allocator->max_order - allocator->base_order && !ret; ++i) {
+        int count = 0;
+        for (MemMetaData *p = allocator->free_list[i]; p && !ret; p = p->next) {
+            const uintptr_t addr = (uintptr_t) p;
+            const uintptr_t end = addr + ((uintptr_t) PAGE_SIZE << i);
+            if (!util_in_range(allocator, addr) || end > allocator->end || addr % (end - addr)
+                || p->MAGIC != MEM_METADATA_MAGIC || ++count > allocator->free_count[i]
+                || (p->next ? p->next->prev != p : allocator->free_tail[i] != p)) {
+                ret = 1;
+                break;
+            }
+            for (uintptr_t page = addr; page < end; page += PAGE_SIZE) {
+                uint8_t *registered = util_registry(allocator, page);
+                if (*registered) {
+                    // registered, within a slab, or within another free block
+                    ret = 1;
+                    break;
+                }
+                *registered = REGISTRY_CHECKING;
+            }
+        }
+        if (count != allocator->free_count[i]) ret = 1;
+        free_pages += (size_t) count << i;
+    }
+    if (free_pages != allocator->free_pages) ret = 1;
+    const int slabs = ret ? 0 : private__registry_check(allocator);
+    if (slabs < 0) ret = 1;
+    // clear the marks
+    const size_t pages = (allocator->end - allocator->start) >> allocator->base_order;
+    for (size_t i = 0; i < pages; ++i) {
+        if (allocator->registry[i] == REGISTRY_CHECKING) allocator->registry[i] = 0;
+    }
+
+    int listed = 0;
+    for (int cpu = 0; cpu < cpu_count() && !ret; ++cpu) {
+        struct slab_manager *manager = &heap->managers[cpu];
+        for (int i = 0; i < SLAB_TYPES * LIFETIMES && !ret; ++i) {
+            SlabMetaData *sentinel = &manager->sentinels[i / SLAB_TYPES][i % SLAB_TYPES];
+            for (SlabMetaData *p = sentinel->next; p != sentinel && !ret; p = p->next) {
+                ret = p->prev->next != p || p->sentinel != sentinel || private__slab_check_consistency(allocator, p)
+                      || ++listed > slabs;
+            }
+        }
+    }
+    // every slab in registry is on the list of its manager
+    if (!ret && listed != slabs) ret = 1;
+
+    lock_release(&allocator->lock);
+    for (int cpu = cpu_count() - 1; cpu >= 0; --cpu) {
+        lock_release(&heap->managers[cpu].lock);
+    }
+    return ret;
+}
+
+int pmm_check() {
+    return pmm_heap_check(DefaultHeap);
+}
+
+/**
+ * @brief create an independent heap which manages [start, end).
+ *
+ * Only sentinels are set up for each cpu here, which is cheap. Slabs are populated on
+ * first use and registry only spans the pages of this heap, so this is no longer a serial
+ * step whose cost depends on the whole address space or cpu_count().
+ * @return the heap; NULL, if the space can't even hold the metadata.
+ */
+struct pmm_heap *pmm_heap_create(uintptr_t start, const uintptr_t end) {
+    // first make room for heap itself and slab managers, and then memory allocator
+    start = ROUNDUP(start, CACHE_LINE_SIZE);
+    // nothing is written before the metadata is known to fit
+    const uintptr_t metadata = ROUNDUP(start + sizeof(struct pmm_heap), CACHE_LINE_SIZE)
+                               + cpu_count() * sizeof(struct slab_manager);
+    if (start >= end || metadata + PAGE_SIZE >= end) return NULL;
+    struct pmm_heap *heap = (struct pmm_heap *) start;
+    start += sizeof(struct pmm_heap);
+    init_slab_managers(heap, &start);
+
+    lock_init(&heap->reclaim_lock);
+    heap->reclaimer_count = 0;
+    heap->reclaiming = 0;
+    memset(heap->tag_quota, 0, sizeof(heap->tag_quota));
+    memset(heap->tag_live, 0, sizeof(heap->tag_live));
+    // ahead of quiescent_epoch of every cpu, so that nothing queued expires until all report
+    heap->epoch = 1;
+
+    init_mem_allocator(&heap->mem, start, end);
+    return heap;
 }
 
 static void pmm_init() {
-    // first make room for slab manager and then memory allocator
-    uintptr_t start = (uintptr_t) heap.start;
-    const uintptr_t end = (uintptr_t) heap.end;
-    init_slab_managers(&start);
-    init_mem_allocator(start, end);
+    DefaultHeap = pmm_heap_create((uintptr_t) heap.start, (uintptr_t) heap.end);
 }
 
 MODULE_DEF(pmm) = {
@@ -545,7 +2594,7 @@ MODULE_DEF(pmm) = {
  */
 static int get_order(const size_t size) {
     // counting leading zeros;
-    return ((int) sizeof(size_t) * 8 - 1) - __builtin_clz(size);
+    return ((int) sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long) size);
 }
 
 /**
@@ -594,7 +2643,7 @@ static int calculate_buddyNum(const uintptr_t addr, const int order) {
  */
 int slab_get_typeIndex(const size_t size) {
     for (int i = 0; i < SLAB_TYPES; ++i) {
-        if (SLAB_CATEGORY[i] >= size) {
+        if ((size_t) SLAB_CATEGORY[i] >= size) {
             return i;
         }
     }
@@ -602,33 +2651,120 @@ int slab_get_typeIndex(const size_t size) {
 }
 
 static int slab_isEmpty(const SlabMetaData *metaData) {
-    return metaData->remaining == (metaData->groups * (sizeof(bitmap) * 8));
+    return (size_t) metaData->remaining == metaData->groups * (sizeof(bitmap) * 8);
 }
 
 /**
- * @brief designed for adding metadata to "MemAllocator's" free_list
+ * @brief designed for adding metadata to the head, i.e. hot end, of "MemAllocator's" free_list
  * @param index the target index of free_list.
  * @param target the target MemMetaDate to be added.
  * @warning index is different from order for MemAllocator.
  */
-static void util_list_addFirst(const int index, MemMetaData *target) {
-    target->next = MemAllocator.free_list[index];
-    MemAllocator.free_list[index] = target;
+static void util_list_addFirst(struct memory_allocator *allocator, const int index, MemMetaData *target) {
+    target->prev = NULL;
+    target->next = allocator->free_list[index];
+    if (target->next) {
+        target->next->prev = target;
+    } else {
+        allocator->free_tail[index] = target;
+    }
+    allocator->free_list[index] = target;
+    allocator->free_count[index]++;
+    __atomic_store_n(&allocator->free_pages, allocator->free_pages + ((size_t) 1 << index), __ATOMIC_RELAXED);
 }
 
 /**
- * @brief designed for removing metadata from "MemAllocator's" free_list
+ * @brief designed for adding metadata to the tail, i.e. cold end, of "MemAllocator's" free_list
+ * @warning index is different from order for MemAllocator.
+ */
+static void util_list_addLast(struct memory_allocator *allocator, const int index, MemMetaData *target) {
+    target->next = NULL;
+    target->prev = allocator->free_tail[index];
+    if (target->prev) {
+        target->prev->next = target;
+    } else {
+        allocator->free_list[index] = target;
+    }
+    allocator->free_tail[index] = target;
+    allocator->free_count[index]++;
+    __atomic_store_n(&allocator->free_pages, allocator->free_pages + ((size_t) 1 << index), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief designed for adding metadata to "MemAllocator's" free_list, where it goes depends
+ * on the placement policy of the allocator, and then whether it's cold.
+ * @warning index is different from order for MemAllocator.
+ */
+static void util_list_add(struct memory_allocator *allocator, const int index, MemMetaData *target, const int cold) {
+    if (allocator->placement == PLACEMENT_LIFO) {
+        if (cold) {
+            util_list_addLast(allocator, index, target);
+        } else {
+            util_list_addFirst(allocator, index, target);
+        }
+        return;
+    }
+    if (!allocator->free_list[index] || (uintptr_t) target < (uintptr_t) allocator->free_list[index]) {
+        util_list_addFirst(allocator, index, target);
+        return;
+    }
+    // find the predecessor which is the last element lower than the target
+    MemMetaData *p = allocator->free_list[index];
+    while (p->next && (uintptr_t) p->next < (uintptr_t) target) p = p->next;
+    target->next = p->next;
+    target->prev = p;
+    if (p->next) {
+        p->next->prev = target;
+    } else {
+        allocator->free_tail[index] = target;
+    }
+    p->next = target;
+    allocator->free_count[index]++;
+    __atomic_store_n(&allocator->free_pages, allocator->free_pages + ((size_t) 1 << index), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief designed for unlinking metadata which is known to be in "MemAllocator's" free_list
+ * @warning index is different from order for MemAllocator.
+ */
+static void util_list_unlink(struct memory_allocator *allocator, const int index, MemMetaData *target) {
+    if (target->prev) {
+        target->prev->next = target->next;
+    } else {
+        allocator->free_list[index] = target->next;
+    }
+    if (target->next) {
+        target->next->prev = target->prev;
+    } else {
+        allocator->free_tail[index] = target->prev;
+    }
+    target->next = target->prev = NULL;
+    allocator->free_count[index]--;
+    __atomic_store_n(&allocator->free_pages, allocator->free_pages - ((size_t) 1 << index), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief designed for removing metadata from the head of "MemAllocator's" free_list
  * @param index the target index of free_list
  * @warning index is different from order for MemAllocator.
  * @pre to use this function, first check whether free_list[index] == NULL or
  * not
  * @return address of first element
  */
-static MemMetaData *util_list_removeFirst(const int index) {
-    MemMetaData *meta = MemAllocator.free_list[index];
-    MemMetaData *nextMeta = meta->next;
-    MemAllocator.free_list[index] = nextMeta;
-    meta->next = NULL;
+static MemMetaData *util_list_removeFirst(struct memory_allocator *allocator, const int index) {
+    MemMetaData *meta = allocator->free_list[index];
+    util_list_unlink(allocator, index, meta);
+    return meta;
+}
+
+/**
+ * @brief designed for removing metadata from the tail of "MemAllocator's" free_list
+ * @pre same as `util_list_removeFirst`
+ * @return address of last element
+ */
+static MemMetaData *util_list_removeLast(struct memory_allocator *allocator, const int index) {
+    MemMetaData *meta = allocator->free_tail[index];
+    util_list_unlink(allocator, index, meta);
     return meta;
 }
 
@@ -642,23 +2778,104 @@ static MemMetaData *util_list_removeFirst(const int index) {
  * @warning index is different from order for MemAllocator.
  * @return NULL, if not found; else the same address as `target_metaAddr`.
  */
-static MemMetaData *util_list_retrieve_with_metaAddr(const int index, const uintptr_t target_metaAddr) {
-    if (!MemAllocator.free_list[index])return NULL; // no element
-    if ((uintptr_t) MemAllocator.free_list[index] == target_metaAddr) {
-        // the first element is target metadata
-        return util_list_removeFirst(index);
-    }
-    // has elements and the first is not the target element.
-    // find the predecessor that just before the target element.
-    MemMetaData *p = MemAllocator.free_list[index];
-    while (p->next && (uintptr_t) p->next != target_metaAddr) p = p->next;
+static MemMetaData *util_list_retrieve_with_metaAddr(struct memory_allocator *allocator, const int index,
+                                                     const uintptr_t target_metaAddr) {
+    MemMetaData *p = allocator->free_list[index];
+    while (p && (uintptr_t) p != target_metaAddr) p = p->next;
     // reached the end and found nothing
-    if (!p->next)return NULL;
+    if (!p) return NULL;
 
-    MemMetaData *targetMeta = (MemMetaData *) target_metaAddr;
-    p->next = targetMeta->next;
-    targetMeta->next = NULL;
-    return targetMeta;
+    util_list_unlink(allocator, index, p);
+    return p;
+}
+
+/**
+ * @brief designed for locating the entry of the given page in "MemAllocator's" registry.
+ * @pre `util_in_range(allocator, addr)`
+ * @return the pointer to the entry, which can be both read and written.
+ */
+static uint8_t *util_registry(struct memory_allocator *allocator, const uintptr_t addr) {
+    return &allocator->registry[(addr - allocator->start) >> allocator->base_order];
+}
+
+/**
+ * @return whether the given address is within the pages managed by "MemAllocator".
+ */
+static int util_in_range(const struct memory_allocator *allocator, const uintptr_t addr) {
+    return addr >= allocator->start && addr < allocator->end;
+}
+
+/**
+ * @brief encode the address of a block into the lower half of a tagged head.
+ */
+static uint64_t util_tagged_encode(const struct memory_allocator *allocator, const MemMetaData *meta) {
+    if (!meta) return 0;
+    return (((uintptr_t) meta - allocator->start) >> allocator->base_order) + 1;
+}
+
+static MemMetaData *util_tagged_decode(const struct memory_allocator *allocator, const uint64_t head) {
+    const uint64_t index = head & 0xffffffff;
+    if (!index) return NULL;
+    return (MemMetaData *) (allocator->start + ((uintptr_t) (index - 1) << allocator->base_order));
+}
+
+/**
+ * @brief designed for pushing a block onto one of "MemAllocator's" fast_list without lock.
+ */
+static void util_tagged_push(struct memory_allocator *allocator, struct tagged_list *list, MemMetaData *target) {
+    uint64_t old = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+    uint64_t new;
+    do {
+        __atomic_store_n(&target->next, util_tagged_decode(allocator, old), __ATOMIC_RELAXED);
+        new = ((old >> 32) + 1) << 32 | util_tagged_encode(allocator, target);
+    } while (!__atomic_compare_exchange_n(&list->head, &old, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    __atomic_add_fetch(&list->count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief designed for popping a block from one of "MemAllocator's" fast_list without lock.
+ * @note `next` of the head may be stale when it is read, because another cpu may have popped
+ * the head meanwhile and be pushing it back, so it is loaded atomically, as push stores it. It
+ * is still safe to read, since the block lies in the heap anyway, and the tag makes sure such a
+ * stale value never gets installed.
+ * @return NULL, if the list is empty; else the popped block.
+ */
+static MemMetaData *util_tagged_pop(struct memory_allocator *allocator, struct tagged_list *list) {
+    uint64_t old = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+    MemMetaData *meta;
+    uint64_t new;
+    do {
+        meta = util_tagged_decode(allocator, old);
+        if (!meta) return NULL;
+        MemMetaData *next = __atomic_load_n(&meta->next, __ATOMIC_RELAXED);
+        new = ((old >> 32) + 1) << 32 | util_tagged_encode(allocator, next);
+    } while (!__atomic_compare_exchange_n(&list->head, &old, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    __atomic_sub_fetch(&list->count, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&meta->next, NULL, __ATOMIC_RELAXED);
+    return meta;
+}
+
+/**
+ * @brief designed for reading one of "MemAllocator's" fast_list without popping anything.
+ * @note other cpus may push and pop meanwhile, so before its `next` is followed, every block is
+ * checked to lie in the heap, to be aligned to its order and to be registered off, as cached
+ * blocks are. The walk stops at the first block that isn't, or after max blocks.
+ * @return how many blocks are stored in addresses.
+ */
+static int util_tagged_walk(struct memory_allocator *allocator, struct tagged_list *list, const int order,
+                            uintptr_t *addresses, const int max) {
+    int n = 0;
+    MemMetaData *meta = util_tagged_decode(allocator, __atomic_load_n(&list->head, __ATOMIC_ACQUIRE));
+    while (meta && n < max) {
+        const uintptr_t addr = (uintptr_t) meta;
+        if (!util_in_range(allocator, addr) || addr % ((uintptr_t) 1 << order)
+            || __atomic_load_n(util_registry(allocator, addr), __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        addresses[n++] = addr;
+        meta = __atomic_load_n(&meta->next, __ATOMIC_RELAXED);
+    }
+    return n;
 }
 
 static int util_bitmap_has_space(const bitmap b) {
@@ -0,0 +1,143 @@
+/**
+ * prints a snapshot written by `host_snapshot_write`, built with the host build. Given NULL, it
+ * writes the default heap, the one behind kalloc, by `pmm_snapshot`:
+ *     pmm_snapshot <file> [pages per line]
+ * - free blocks and blocks cached in fast lists, of every order;
+ * - occupancy of every slab type, summed up over cpus and lifetimes;
+ * - a map of the heap, one character per page: '.' free, 'f' cached in a fast list, 'P' a page
+ *   block, 'S' a slab, 'M' a block from `mem_allocate`, and ' ' none of them.
+ */
+#include "host.h"
+
+struct reader {
+    const uint8_t *buf;
+    size_t len, pos;
+};
+
+static const void *take(struct reader *reader, const size_t size) {
+    CHECK(reader->pos + size <= reader->len);
+    const void *p = reader->buf + reader->pos;
+    reader->pos += size;
+    return p;
+}
+
+static uint32_t take_u32(struct reader *reader) {
+    uint32_t value;
+    memcpy(&value, take(reader, sizeof(value)), sizeof(value));
+    return value;
+}
+
+static uint64_t take_u64(struct reader *reader) {
+    uint64_t value;
+    memcpy(&value, take(reader, sizeof(value)), sizeof(value));
+    return value;
+}
+
+static void mark(char *map, const uint32_t pages, const uint64_t first, const uint64_t count, const char c) {
+    for (uint64_t i = first; i < first + count && i < pages; ++i) {
+        map[i] = c;
+    }
+}
+
+/**
+ * @brief read `count, address[count]` of blocks of the given order and mark them in map.
+ * @return count
+ */
+static uint32_t take_blocks(struct reader *reader, const struct pmm_snapshot_header *header, char *map,
+                            const uint32_t order, const char c) {
+    const uint32_t count = take_u32(reader);
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t address = take_u64(reader);
+        mark(map, header->pages, address >> header->base_order, (uint64_t) 1 << (order - header->base_order), c);
+    }
+    return count;
+}
+
+int main(const int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [pages per line]\n", argv[0]);
+        return 1;
+    }
+    const int width = argc > 2 ? atoi(argv[2]) : 64;
+    CHECK(width > 0);
+    size_t len;
+    uint8_t *buf = host_snapshot_read(argv[1], &len);
+    if (!buf) {
+        fprintf(stderr, "%s: not a snapshot of version %d\n", argv[1], PMM_SNAPSHOT_VERSION);
+        return 1;
+    }
+    struct reader reader = {buf, len, 0};
+    struct pmm_snapshot_header header;
+    memcpy(&header, take(&reader, sizeof(header)), sizeof(header));
+    CHECK(header.base_order <= header.max_order && header.max_order < 64);
+    char *map = malloc(header.pages + 1);
+    CHECK(map);
+    memset(map, ' ', header.pages);
+
+    printf("heap [0x%llx, 0x%llx), %u pages of %u bytes, %u cpus\n", (unsigned long long) header.start,
+           (unsigned long long) header.end, header.pages, 1u << header.base_order, header.cpus);
+    printf("%6s %8s %8s\n", "order", "free", "fast");
+    uint32_t free_blocks[64] = {0}, fast_blocks[64] = {0};
+    for (uint32_t order = header.base_order; order <= header.max_order; ++order) {
+        free_blocks[order] = take_blocks(&reader, &header, map, order, '.');
+    }
+    for (uint32_t i = 0; i < header.fast_orders; ++i) {
+        fast_blocks[header.base_order + i] = take_blocks(&reader, &header, map, header.base_order + i, 'f');
+    }
+    for (uint32_t order = header.base_order; order <= header.max_order; ++order) {
+        if (free_blocks[order] || fast_blocks[order]) printf("%6u %8u %8u\n", order, free_blocks[order], fast_blocks[order]);
+    }
+
+    const uint8_t *registry = take(&reader, header.pages);
+    for (uint32_t i = 0; i < header.pages; ++i) {
+        const uint8_t entry = registry[i];
+        if (entry & REGISTRY_SLAB) {
+            map[i] = 'S';
+        } else if (entry & REGISTRY_PAGE) {
+            mark(map, header.pages, i, (uint64_t) 1 << ((entry & ~REGISTRY_PAGE) - header.base_order), 'P');
+        } else if (entry >= header.base_order) {
+            mark(map, header.pages, i, (uint64_t) 1 << (entry - header.base_order), 'M');
+        }
+    }
+
+    // slab occupancy, index <- type
+    CHECK(header.slab_types <= 64);
+    uint32_t type_size[64] = {0}, slabs[64] = {0};
+    uint64_t cells[64] = {0}, used[64] = {0};
+    for (uint32_t cpu = 0; cpu < header.cpus; ++cpu) {
+        take(&reader, header.slab_types * sizeof(uint32_t)); // populated
+        take_u32(&reader); // zeroed_count
+        take_u32(&reader); // deferred_count
+        for (uint32_t i = 0; i < header.slab_types * header.lifetimes; ++i) {
+            take_u32(&reader); // grow_pages
+            const uint32_t n = take_u32(&reader);
+            for (uint32_t j = 0; j < n; ++j) {
+                struct pmm_snapshot_slab slab;
+                memcpy(&slab, take(&reader, sizeof(slab)), sizeof(slab));
+                take(&reader, slab.groups * sizeof(bitmap));
+                const uint32_t type = i % header.slab_types;
+                const uint64_t capacity = (uint64_t) slab.groups * sizeof(bitmap) * 8;
+                type_size[type] = slab.type_size;
+                slabs[type]++;
+                cells[type] += capacity;
+                used[type] += capacity - slab.remaining;
+            }
+        }
+    }
+    printf("%6s %8s %10s %10s %6s\n", "type", "slabs", "cells", "used", "used%");
+    for (uint32_t type = 0; type < header.slab_types; ++type) {
+        if (!slabs[type]) continue;
+        printf("%6u %8u %10llu %10llu %6llu\n", type_size[type], slabs[type], (unsigned long long) cells[type],
+               (unsigned long long) used[type], (unsigned long long) (used[type] * 100 / cells[type]));
+    }
+    CHECK(reader.pos == reader.len);
+
+    printf("map, one page per character: '.' free, 'f' fast list, 'P' page block, 'S' slab, 'M' mem block\n");
+    for (uint32_t i = 0; i < header.pages; i += width) {
+        const uint32_t n = header.pages - i < (uint32_t) width ? header.pages - i : (uint32_t) width;
+        printf("0x%08llx %.*s\n", (unsigned long long) ((uint64_t) i << header.base_order), (int) n, map + i);
+    }
+    free(map);
+    free(buf);
+    return 0;
+}